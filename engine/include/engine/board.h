@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace la
@@ -58,20 +59,64 @@ struct Piece
 // Byte 3: the promotion piece type (can be NONE)
 using Move = std::uint32_t;
 
+// Compact moves pack a move into 16 bits for storage:
+// Bits 0-5: the start square (0-35)
+// Bits 6-11: the end square (0-35)
+// Bits 12-13: the promotion (none, knight, rook or queen)
+// The capture isn't stored, so a compact move is expanded using the position it was played in.
+using CompactMove = std::uint16_t;
+
 namespace move
 {
 inline PieceType get_cap(Move m)
 { return static_cast<la::PieceType>((m & 0xFF0000) >> 16); }
 inline PieceType get_promo(Move m)
 { return static_cast<PieceType>((m & 0xFF000000) >> 24); }
+
+// The null move is zero in both encodings.
+CompactMove to_compact(Move);
 }
 
+// Material keys count each side's non-king pieces in 4-bit fields, so the key for a set of pieces
+// is the sum of the keys of the individual pieces.
+namespace material
+{
+using Key = std::uint32_t;
+
+constexpr Key piece_key(Colour col, PieceType pt)
+{
+  const int side_shift = col == Colour::WHITE ? 0 : 16;
+  switch (pt)
+  {
+    case PieceType::PAWN_WHITE:
+    case PieceType::PAWN_BLACK: return Key(1) << side_shift;
+    case PieceType::KNIGHT:     return Key(1) << (side_shift + 4);
+    case PieceType::ROOK:       return Key(1) << (side_shift + 8);
+    case PieceType::QUEEN:      return Key(1) << (side_shift + 12);
+    default:                    return 0;
+  }
+}
+
+// Convert between material keys and names like "KQvKR" (white's pieces first).
+Key from_string(const std::string&);
+std::string to_string(Key);
+}
+
+// A checksum of the Zobrist keys behind Board::hash. Hashes saved by one build only describe the
+// same positions in builds with the same fingerprint.
+std::uint64_t zobrist_fingerprint();
+
 class BoardImpl;
 
 class Board
 {
 public:
   Board();
+  // Set up a position from FEN-style notation, e.g. "rnqknr/pppppp/6/6/PPPPPP/RNQKNR w".
+  // The side to move can be followed by the halfmove clock, e.g. "... w 12", which to_fen omits
+  // when it's zero.
+  // Throws std::invalid_argument if the notation is malformed.
+  explicit Board(const std::string& fen);
   Board(const Board&);
   Board& operator=(const Board&);
 
@@ -79,6 +124,8 @@ public:
 
   Colour player_to_move() const;
   std::vector<Move> get_moves(MoveGenType type = MoveGenType::ALL) const;
+  // Replaces the contents of the vector, so a reused vector doesn't allocate.
+  void get_moves(std::vector<Move>&, MoveGenType type = MoveGenType::ALL) const;
   std::vector<int> get_targets_for_piece(int, int) const;
 
   void make_move(Move);
@@ -90,11 +137,20 @@ public:
 
   int score() const; // The score from the current player's perspective.
   std::uint64_t hash() const;
+  material::Key material_key() const;
+  std::uint64_t pawn_hash() const; // Depends only on where each side's pawns are.
+  int king_location(Colour) const;
   bool in_check() const;
   bool is_draw() const;
+  int halfmove_clock() const; // Plies since the last pawn move or capture.
+  int game_ply() const; // Moves, including null moves, made since the position was set up.
   std::optional<Piece> get_piece(int, int) const;
 
+  // The move may not be legal if the compact move came from another position.
+  Move from_compact(CompactMove) const;
+
   std::string move_to_string(Move) const;
+  std::string to_fen() const;
 
 private:
   std::unique_ptr<BoardImpl> impl_;
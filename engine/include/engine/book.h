@@ -0,0 +1,32 @@
+#pragma once
+
+#include "engine/board.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Opening book: precomputed moves for positions near the start of the game.
+namespace la::book
+{
+
+// A book is a record file of these entries, sorted by hash.
+struct Entry
+{
+  static constexpr std::uint32_t record_type = 1;
+
+  std::uint64_t hash;
+  Move move;
+  std::int32_t score; // From the perspective of the player to move.
+};
+
+static_assert(sizeof(Entry) == 16);
+
+// Map the book file, returning the number of entries.
+// Throws std::runtime_error if the file is not a valid book.
+std::size_t init(const std::string& path);
+
+// If the position is in the book then return its entry.
+std::optional<Entry> probe(const Board&);
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "engine/board.h"
+
+namespace la::endgame
+{
+
+// Scores for recognised wins start here, so they are always preferred to any material advantage
+// but never to a mate.
+constexpr int known_win_score = 10000;
+
+enum class RecogniserType : std::uint8_t
+{
+  DRAW,    // Neither side can force a win, so the position is scored as a draw. A blunder can
+           // still allow mate, e.g. in KNvKN, but the search doesn't look for one.
+  EVALUATE // The position should be scored with the recogniser's evaluation function.
+};
+
+struct Recogniser
+{
+  material::Key key;
+  RecogniserType type;
+  int (*evaluate)(const Board&); // The score from the current player's perspective.
+};
+
+// Find the recogniser for the material on the board (if there is one).
+const Recogniser* probe(const Board&);
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Counters and cycle timers for the board and search hot paths.
+// Building with LA_INSTRUMENT defined enables the counters, and LA_INSTRUMENT_TIMERS the timers as
+// well. Otherwise the macros below expand to nothing. Each thread counts into its own storage,
+// which is added to the process totals by LA_AGGREGATE, e.g. at the end of a search.
+namespace la::instrument
+{
+
+enum class Counter
+{
+  GET_MOVES,
+  WILL_BE_IN_CHECK,
+  MAKE_MOVE,
+  TT_PROBE,
+  TT_HIT,
+  TT_STORE,
+  QUIESCE,
+  NULL_MOVE_ATTEMPT,
+  NULL_MOVE_CUTOFF,
+  NUM_COUNTERS
+};
+
+// Timers are inclusive: a timed call includes the timed calls it makes, e.g. GET_MOVES includes
+// the WILL_BE_IN_CHECK calls which filter out illegal moves. So the totals overlap and shouldn't be
+// added together.
+enum class Timer
+{
+  GET_MOVES,
+  WILL_BE_IN_CHECK,
+  MAKE_MOVE,
+  NUM_TIMERS
+};
+
+// Cut-offs are counted by the index of the move which caused them. The last bucket counts the
+// rest.
+constexpr std::size_t num_cutoff_buckets = 8;
+
+struct Stats
+{
+  std::array<std::uint64_t, static_cast<std::size_t>(Counter::NUM_COUNTERS)> counters = {};
+  std::array<std::uint64_t, static_cast<std::size_t>(Timer::NUM_TIMERS)> cycles = {};
+  std::array<std::uint64_t, num_cutoff_buckets> cutoffs = {};
+
+  void add(const Stats&);
+};
+
+// This thread's counts since it last aggregated.
+Stats& thread_stats();
+
+// Add this thread's counts to the totals and reset them.
+void aggregate();
+
+// The totals aggregated so far.
+Stats totals();
+void reset();
+
+std::string to_string(const Stats&);
+
+inline std::uint64_t read_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(Timer timer) : timer_(timer), start_(read_cycles()) {}
+  ~ScopedTimer()
+  {
+    thread_stats().cycles[static_cast<std::size_t>(timer_)] += read_cycles() - start_;
+  }
+
+private:
+  Timer timer_;
+  std::uint64_t start_;
+};
+
+}
+
+#define LA_INSTRUMENT_CONCAT_(a, b) a##b
+#define LA_INSTRUMENT_CONCAT(a, b) LA_INSTRUMENT_CONCAT_(a, b)
+
+#if defined(LA_INSTRUMENT)
+#define LA_COUNT(counter) \
+  (++::la::instrument::thread_stats().counters[static_cast<std::size_t>(::la::instrument::Counter::counter)])
+#define LA_COUNT_CUTOFF(move_index) \
+  (++::la::instrument::thread_stats().cutoffs[ \
+    std::min<std::size_t>(move_index, ::la::instrument::num_cutoff_buckets - 1)])
+#define LA_AGGREGATE() ::la::instrument::aggregate()
+#else
+#define LA_COUNT(counter) ((void)0)
+#define LA_COUNT_CUTOFF(move_index) ((void)0)
+#define LA_AGGREGATE() ((void)0)
+#endif
+
+#if defined(LA_INSTRUMENT) && defined(LA_INSTRUMENT_TIMERS)
+#define LA_TIME(timer) \
+  const ::la::instrument::ScopedTimer LA_INSTRUMENT_CONCAT(la_timer_, __LINE__)(::la::instrument::Timer::timer)
+#else
+#define LA_TIME(timer) ((void)0)
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace la
+{
+
+// A memory mapping of a whole file.
+class MappedFile
+{
+public:
+  enum class Mode
+  {
+    READ_ONLY,
+    COPY_ON_WRITE // Writable, but writes copy the page instead of changing the file.
+  };
+
+  MappedFile() = default;
+  // Throws std::runtime_error if the file can't be mapped.
+  explicit MappedFile(const std::string& path, Mode mode = Mode::READ_ONLY);
+  MappedFile(MappedFile&&);
+  MappedFile& operator=(MappedFile&&);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile();
+
+  const std::uint8_t* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  // Null unless the file was mapped copy-on-write.
+  std::uint8_t* writable_data() const { return writable_ ? data_ : nullptr; }
+
+private:
+  std::uint8_t* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool writable_ = false;
+
+  void unmap();
+};
+
+}
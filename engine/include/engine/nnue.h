@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+// An efficiently updatable neural network evaluation, which replaces the built-in piece-square
+// evaluation once a network has been loaded.
+namespace la::nnue
+{
+
+// Load network weights from a file. Throws std::runtime_error if the file isn't a valid network.
+void load(const std::string& path);
+
+bool loaded();
+
+}
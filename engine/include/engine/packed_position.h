@@ -0,0 +1,33 @@
+#pragma once
+
+#include "engine/board.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+namespace la
+{
+
+// A fixed-size encoding of a position for storing in bulk.
+// Each square is a 4-bit code: 0 when empty, else the piece type with 6 added for black's pieces.
+// Squares are ordered by row then column, two to a byte with the lower numbered square in the
+// low nibble.
+struct PackedPosition
+{
+  std::array<std::uint8_t, board_side * board_side / 2> squares;
+  std::uint8_t player_to_move;
+  std::uint8_t halfmove_clock; // Saturates at 255.
+
+  static PackedPosition from_board(const Board&);
+
+  // Throws std::invalid_argument if the encoding is malformed.
+  Board to_board() const;
+
+  std::optional<Piece> get_piece(int row, int col) const;
+  Colour get_player_to_move() const { return static_cast<Colour>(player_to_move); }
+};
+
+static_assert(sizeof(PackedPosition) == 20);
+
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "engine/mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace la
+{
+
+// Files of fixed-size records, e.g. PackedPositions, for storing and scanning large datasets.
+// A file is this header followed by the records.
+// RecordType must have a `record_type` constant which no other record type shares, so that a file
+// can't be read as a different type of the same size. The types in use are:
+//   1: book::Entry
+//   2: TrainingRecord
+struct RecordFileHeader
+{
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t record_size;
+  std::uint32_t record_type;
+  std::uint64_t num_records;
+};
+
+constexpr char record_file_magic[4] = { 'L', 'A', 'R', 'F' };
+constexpr std::uint32_t record_file_version = 2;
+
+// Whether the file starts with a record file header.
+inline bool is_record_file(const std::string& path)
+{
+  char magic[sizeof(record_file_magic)] = {};
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  const bool read = std::fread(magic, sizeof(magic), 1, file) == 1;
+  std::fclose(file);
+  return read && std::memcmp(magic, record_file_magic, sizeof(magic)) == 0;
+}
+
+// Appends records to a file through a buffer. The header's count is written on close.
+// Writes throw std::runtime_error if they fail, e.g. when the disk is full. The destructor closes
+// the file but can't report errors, so call close to find out whether the file is complete.
+template <typename RecordType, std::size_t buffer_records = 4096>
+class RecordWriter
+{
+static_assert(std::is_trivially_copyable<RecordType>::value);
+public:
+  // Throws std::runtime_error if the file can't be created.
+  explicit RecordWriter(const std::string& path);
+  RecordWriter(const RecordWriter&) = delete;
+  RecordWriter& operator=(const RecordWriter&) = delete;
+  ~RecordWriter();
+
+  void write(const RecordType&);
+  void write(const RecordType*, std::size_t count);
+  void close();
+
+  std::uint64_t num_records() const { return num_records_; }
+
+private:
+  std::string path_;
+  std::FILE* file_;
+  std::vector<RecordType> buffer_;
+  std::uint64_t num_records_ = 0;
+
+  void flush();
+  [[noreturn]] void fail();
+};
+
+template <typename RecordType, std::size_t buffer_records>
+RecordWriter<RecordType, buffer_records>::RecordWriter(const std::string& path)
+  : path_(path), file_(std::fopen(path.c_str(), "wb"))
+{
+  if (!file_)
+  {
+    throw std::runtime_error("Could not create " + path);
+  }
+
+  buffer_.reserve(buffer_records);
+
+  // The count is filled in on close.
+  const RecordFileHeader header = {
+    { record_file_magic[0], record_file_magic[1], record_file_magic[2], record_file_magic[3] },
+    record_file_version,
+    sizeof(RecordType),
+    RecordType::record_type,
+    0 };
+
+  if (std::fwrite(&header, sizeof(header), 1, file_) != 1)
+  {
+    fail();
+  }
+}
+
+template <typename RecordType, std::size_t buffer_records>
+RecordWriter<RecordType, buffer_records>::~RecordWriter()
+{
+  try
+  {
+    close();
+  }
+  catch (const std::runtime_error&)
+  {
+  }
+}
+
+template <typename RecordType, std::size_t buffer_records>
+void RecordWriter<RecordType, buffer_records>::write(const RecordType& record)
+{
+  buffer_.push_back(record);
+  if (buffer_.size() == buffer_records)
+  {
+    flush();
+  }
+}
+
+template <typename RecordType, std::size_t buffer_records>
+void RecordWriter<RecordType, buffer_records>::write(const RecordType* records, std::size_t count)
+{
+  flush();
+  if (!file_ || std::fwrite(records, sizeof(RecordType), count, file_) != count)
+  {
+    fail();
+  }
+
+  num_records_ += count;
+}
+
+template <typename RecordType, std::size_t buffer_records>
+void RecordWriter<RecordType, buffer_records>::flush()
+{
+  if (!file_ ||
+      std::fwrite(buffer_.data(), sizeof(RecordType), buffer_.size(), file_) != buffer_.size())
+  {
+    fail();
+  }
+
+  num_records_ += buffer_.size();
+  buffer_.clear();
+}
+
+template <typename RecordType, std::size_t buffer_records>
+void RecordWriter<RecordType, buffer_records>::close()
+{
+  if (!file_)
+  {
+    return;
+  }
+
+  flush();
+  const bool written =
+    std::fseek(file_, offsetof(RecordFileHeader, num_records), SEEK_SET) == 0 &&
+    std::fwrite(&num_records_, sizeof(num_records_), 1, file_) == 1;
+
+  const bool closed = std::fclose(file_) == 0;
+  file_ = nullptr;
+  if (!written || !closed)
+  {
+    throw std::runtime_error("Failed to write " + path_);
+  }
+}
+
+// The file is abandoned, so later writes fail too and the destructor doesn't try to finish it.
+template <typename RecordType, std::size_t buffer_records>
+void RecordWriter<RecordType, buffer_records>::fail()
+{
+  if (file_)
+  {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  buffer_.clear();
+  throw std::runtime_error("Failed to write " + path_);
+}
+
+// Maps a record file so that its records can be read in place.
+template <typename RecordType>
+class RecordReader
+{
+static_assert(std::is_trivially_copyable<RecordType>::value);
+public:
+  // Throws std::runtime_error if the file can't be mapped or doesn't hold this type of record.
+  explicit RecordReader(const std::string& path);
+
+  const RecordType* begin() const { return records_; }
+  const RecordType* end() const { return records_ + size_; }
+  std::size_t size() const { return size_; }
+  const RecordType& operator[](std::size_t i) const { return records_[i]; }
+
+private:
+  MappedFile file_;
+  const RecordType* records_;
+  std::size_t size_;
+};
+
+template <typename RecordType>
+RecordReader<RecordType>::RecordReader(const std::string& path)
+  : file_(path)
+{
+  RecordFileHeader header;
+  if (file_.size() < sizeof(header))
+  {
+    throw std::runtime_error(path + " is too small to be a record file");
+  }
+
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, record_file_magic, sizeof(header.magic)) != 0 ||
+      header.version != record_file_version)
+  {
+    throw std::runtime_error(path + " is not a record file");
+  }
+
+  if (header.record_size != sizeof(RecordType) ||
+      header.record_type != RecordType::record_type ||
+      file_.size() != sizeof(header) + header.num_records * sizeof(RecordType))
+  {
+    throw std::runtime_error(path + " does not hold the expected records");
+  }
+
+  records_ = reinterpret_cast<const RecordType*>(file_.data() + sizeof(header));
+  size_ = header.num_records;
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace la
+{
+
+// A read-write mapping of a named POSIX shared memory segment, which other processes can map by
+// the same name. The segment outlives the processes using it until it's removed.
+class SharedMemory
+{
+public:
+  SharedMemory() = default;
+  // Opens the segment, creating it zero-filled if it doesn't exist. The name should start with a
+  // slash, e.g. "/la_hash". Throws std::runtime_error if the segment can't be mapped or already
+  // exists with a different size.
+  SharedMemory(const std::string& name, std::size_t size);
+  SharedMemory(SharedMemory&&);
+  SharedMemory& operator=(SharedMemory&&);
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+
+  ~SharedMemory();
+
+  std::uint8_t* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  // Whether this mapping created the segment.
+  bool created() const { return created_; }
+
+  // Remove the name, so that the segment is freed once every process has unmapped it.
+  static void remove(const std::string& name);
+
+private:
+  std::uint8_t* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool created_ = false;
+
+  void unmap();
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "engine/board.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Endgame tablebases: the exact result of every position with a given set of pieces.
+namespace la::tablebase
+{
+
+// Each position's result is stored in a single byte:
+// 0:       a draw
+// 1-125:   the side to move mates in this many plies
+// 128-253: the side to move is mated in (value - 128) plies
+// 255:     the position is illegal
+using Value = std::uint8_t;
+
+constexpr Value draw = 0;
+constexpr Value illegal = 0xFF;
+constexpr int max_plies = 125;
+
+constexpr Value win_in(int plies) { return static_cast<Value>(plies); }
+constexpr Value loss_in(int plies) { return static_cast<Value>(0x80 | plies); }
+constexpr bool is_win(Value v) { return v != draw && v < 0x80; }
+constexpr bool is_loss(Value v) { return v >= 0x80 && v != illegal; }
+constexpr int plies_to_mate(Value v) { return v & 0x7F; }
+
+// A table file is this header followed by one value per position index.
+struct FileHeader
+{
+  char magic[4];
+  std::uint32_t version;
+  material::Key material_key;
+  std::uint64_t num_entries;
+};
+
+constexpr char file_magic[4] = { 'L', 'A', 'T', 'B' };
+constexpr std::uint32_t file_version = 2;
+constexpr const char* file_extension = ".latb";
+
+// The pieces covered by a table, in the order they are indexed: white's king then its queens,
+// rooks, knights and pawns, followed by black's pieces in the same order.
+std::vector<Piece> pieces(material::Key);
+
+// The number of position indices for the given pieces.
+std::size_t table_size(const std::vector<Piece>&);
+
+// Index a position by the side to move and then the square of each piece in turn.
+// The board's material must match the pieces.
+std::size_t index(const Board&, const std::vector<Piece>&);
+
+// Map every table file in the directory, returning the number loaded.
+// Throws std::runtime_error if a table file is invalid, in which case none of them are loaded.
+int init(const std::string& directory);
+
+// If there is a table for the position then return its search score.
+std::optional<int> probe(const Board&);
+
+}
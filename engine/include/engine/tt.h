@@ -1,37 +1,405 @@
 #pragma once
 
+#include "engine/board.h"
+#include "engine/mapped_file.h"
+#include "engine/shared_memory.h"
+
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace la
 {
 
-// EntryType must be POD and it must have a public `hash` member.
-template <typename EntryType, std::size_t max_entries>
+// EntryType must be POD. probe and the default hashfull also need it to have a public `hash`
+// member. Entries which keep their own keys, e.g. buckets of smaller entries, use slot and pass
+// hashfull a predicate instead.
+// The table is either private to the process or mapped from a named shared memory segment, so
+// that several processes can search with the same table. Entries which are written concurrently,
+// by threads or processes, need to be safe to tear.
+template <typename EntryType>
 class TT
 {
 static_assert(std::is_pod<EntryType>::value);
 public:
-  TT();
+  explicit TT(std::size_t num_entries);
+  // Throws std::runtime_error if the shared table can't be mapped. See attach.
+  TT(std::size_t num_entries, const std::string& shared_name);
+
+  // Points the entry at the hash's slot and returns whether the slot holds that hash.
   bool probe(std::uint64_t hash, EntryType** entry);
 
+  // The entry for a hash, whether or not it holds that hash.
+  EntryType* slot(std::uint64_t hash) { return &entries_[hash % size_]; }
+
+  std::size_t size() const { return size_; }
+
+  // The name of the shared memory segment, or an empty string for a private table.
+  const std::string& shared_name() const { return shared_name_; }
+
+  // Resizing discards the table's contents and makes it private.
+  void resize(std::size_t num_entries);
+
+  // Share the table with any other processes which attach by the same name. The first to attach
+  // creates the segment and the rest see its contents. Throws std::runtime_error if an existing
+  // segment holds a table with a different layout.
+  void attach(const std::string& shared_name, std::size_t num_entries);
+
+  void clear();
+
+  // Each search takes the next generation, so that entries can be told apart from those of earlier
+  // searches. A shared table keeps the counter in its header, so every process sharing the table
+  // counts the same generations. Setting the generation makes the next search's the one after, e.g.
+  // so that entries loaded from a snapshot are the next search's.
+  std::uint32_t next_generation();
+  void set_generation(std::uint32_t);
+
+  // Snapshots save the table to a file so that a later process can start from its contents. They
+  // need EntryType to have a `layout_version` constant, which must change whenever the meaning of
+  // its bytes does.
+  // A full snapshot is an image of the table which loads by mapping the file copy-on-write, so
+  // entries are only read from disk when they're probed. A compact snapshot holds just the entries
+  // selected by the predicate, along with their positions in the table. The predicate is given a
+  // copy of each entry, which it may trim before it's saved.
+  // Throws std::runtime_error if the file can't be written.
+  void save(const std::string& path) const;
+  template <typename Predicate>
+  void save(const std::string& path, Predicate keep) const;
+
+  // Replaces the table with a snapshot of either kind, taking the snapshot's size. Throws
+  // std::runtime_error if the file isn't a snapshot of this kind of table from a build with the
+  // same Zobrist keys.
+  void load(const std::string& path);
+
+  // An estimate of the entries per thousand which are in use, from a sample of the table.
+  // By default entries with a non-zero hash are in use. The predicate may instead return the
+  // proportion in use, e.g. of an entry which is a bucket of smaller entries.
+  template <typename Predicate>
+  int hashfull(Predicate in_use) const;
+  int hashfull() const { return hashfull([] (const EntryType& e) { return e.hash != 0; }); }
+
 private:
-  std::vector<EntryType> entries_;
+  // Shared tables start with a header so that processes can check they agree on the layout.
+  struct alignas(64) SharedHeader
+  {
+    char magic[8];
+    std::uint64_t entry_size;
+    std::uint64_t num_entries;
+    std::uint32_t ready;
+    std::uint32_t generation;
+  };
+
+  static constexpr char shared_magic[8] = { 'L', 'A', 'T', 'T', 'S', 'H', 'M', '2' };
+
+  // Snapshots start with a header which is padded so that a full snapshot's entries are aligned
+  // when it's mapped.
+  struct alignas(64) SnapshotHeader
+  {
+    char magic[8];
+    std::uint32_t compact;
+    std::uint32_t layout_version;
+    std::uint64_t entry_size;
+    std::uint64_t zobrist_fingerprint;
+    std::uint64_t num_entries;
+    std::uint64_t num_saved; // For compact snapshots.
+  };
+
+  static constexpr char snapshot_magic[8] = { 'L', 'A', 'T', 'T', 'S', 'N', 'P', '\0' };
+
+  SnapshotHeader snapshot_header(bool compact, std::uint64_t num_saved) const;
+  void check_snapshot_header(const SnapshotHeader&, const std::string& path) const;
+  void use_private_entries(std::size_t num_entries);
+
+  std::vector<EntryType> private_entries_;
+  SharedMemory shared_;
+  MappedFile snapshot_;
+  std::string shared_name_;
+  EntryType* entries_ = nullptr;
+  std::size_t size_ = 0;
+  std::uint32_t generation_ = 0; // For private tables.
+
+  std::uint32_t* shared_generation()
+  {
+    return &reinterpret_cast<SharedHeader*>(shared_.data())->generation;
+  }
 };
 
-template <typename EntryType, std::size_t max_entries>
-TT<EntryType, max_entries>::TT()
+template <typename EntryType>
+TT<EntryType>::TT(std::size_t num_entries)
 {
-  entries_.resize(max_entries);
-  std::memset(entries_.data(), 0, max_entries * sizeof(EntryType));
+  resize(num_entries);
 }
 
-template <typename EntryType, std::size_t max_entries>
-bool TT<EntryType, max_entries>::probe(std::uint64_t hash, EntryType** entry)
+template <typename EntryType>
+TT<EntryType>::TT(std::size_t num_entries, const std::string& shared_name)
 {
-  *entry = &entries_[hash % max_entries];
+  attach(shared_name, num_entries);
+}
+
+template <typename EntryType>
+void TT<EntryType>::resize(std::size_t num_entries)
+{
+  use_private_entries(num_entries > 0 ? num_entries : 1);
+  clear();
+}
+
+template <typename EntryType>
+void TT<EntryType>::use_private_entries(std::size_t num_entries)
+{
+  shared_ = SharedMemory();
+  shared_name_.clear();
+  snapshot_ = MappedFile();
+
+  private_entries_.clear();
+  private_entries_.shrink_to_fit();
+  private_entries_.resize(num_entries);
+  entries_ = private_entries_.data();
+  size_ = private_entries_.size();
+}
+
+template <typename EntryType>
+void TT<EntryType>::attach(const std::string& shared_name, std::size_t num_entries)
+{
+  num_entries = num_entries > 0 ? num_entries : 1;
+  SharedMemory shared(shared_name, sizeof(SharedHeader) + num_entries * sizeof(EntryType));
+  auto* header = reinterpret_cast<SharedHeader*>(shared.data());
+
+  // A new segment is already zero-filled, so only the header needs writing. Other processes wait
+  // until it's ready before checking it.
+  if (shared.created())
+  {
+    std::memcpy(header->magic, shared_magic, sizeof(shared_magic));
+    header->entry_size = sizeof(EntryType);
+    header->num_entries = num_entries;
+    __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+  }
+  else
+  {
+    for (int attempt = 0; !__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) && attempt < 1000; attempt++)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (!__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) ||
+        std::memcmp(header->magic, shared_magic, sizeof(shared_magic)) != 0 ||
+        header->entry_size != sizeof(EntryType) ||
+        header->num_entries != num_entries)
+    {
+      throw std::runtime_error("Shared memory " + shared_name + " holds an incompatible table");
+    }
+  }
+
+  private_entries_.clear();
+  private_entries_.shrink_to_fit();
+  snapshot_ = MappedFile();
+  shared_ = std::move(shared);
+  shared_name_ = shared_name;
+  entries_ = reinterpret_cast<EntryType*>(shared_.data() + sizeof(SharedHeader));
+  size_ = num_entries;
+}
+
+template <typename EntryType>
+void TT<EntryType>::clear()
+{
+  std::memset(static_cast<void*>(entries_), 0, size_ * sizeof(EntryType));
+}
+
+template <typename EntryType>
+std::uint32_t TT<EntryType>::next_generation()
+{
+  return shared_name_.empty()
+    ? ++generation_
+    : __atomic_add_fetch(shared_generation(), 1, __ATOMIC_RELAXED);
+}
+
+template <typename EntryType>
+void TT<EntryType>::set_generation(std::uint32_t generation)
+{
+  if (shared_name_.empty())
+  {
+    generation_ = generation;
+  }
+  else
+  {
+    __atomic_store_n(shared_generation(), generation, __ATOMIC_RELAXED);
+  }
+}
+
+template <typename EntryType>
+typename TT<EntryType>::SnapshotHeader TT<EntryType>::snapshot_header(
+  bool compact,
+  std::uint64_t num_saved) const
+{
+  SnapshotHeader header = {};
+  std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+  header.compact = compact;
+  header.layout_version = EntryType::layout_version;
+  header.entry_size = sizeof(EntryType);
+  header.zobrist_fingerprint = zobrist_fingerprint();
+  header.num_entries = size_;
+  header.num_saved = num_saved;
+  return header;
+}
+
+template <typename EntryType>
+void TT<EntryType>::check_snapshot_header(const SnapshotHeader& header, const std::string& path) const
+{
+  if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0)
+  {
+    throw std::runtime_error(path + " is not a table snapshot");
+  }
+
+  if (header.layout_version != EntryType::layout_version || header.entry_size != sizeof(EntryType))
+  {
+    throw std::runtime_error(path + " holds a different kind of entry");
+  }
+
+  if (header.zobrist_fingerprint != zobrist_fingerprint())
+  {
+    throw std::runtime_error(path + " was saved with different Zobrist keys");
+  }
+
+  if (header.num_entries == 0)
+  {
+    throw std::runtime_error(path + " is empty");
+  }
+}
+
+template <typename EntryType>
+void TT<EntryType>::save(const std::string& path) const
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    throw std::runtime_error("Could not create " + path);
+  }
+
+  const auto header = snapshot_header(false, size_);
+  const bool written =
+    std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+    std::fwrite(entries_, sizeof(EntryType), size_, file) == size_;
+
+  if (std::fclose(file) != 0 || !written)
+  {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+template <typename EntryType>
+template <typename Predicate>
+void TT<EntryType>::save(const std::string& path, Predicate keep) const
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    throw std::runtime_error("Could not create " + path);
+  }
+
+  // Each saved entry is preceded by its index. The count is known once they've been written.
+  auto header = snapshot_header(true, 0);
+  bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  for (std::uint64_t i = 0; i < size_ && written; i++)
+  {
+    EntryType entry = entries_[i];
+    if (keep(entry))
+    {
+      written =
+        std::fwrite(&i, sizeof(i), 1, file) == 1 &&
+        std::fwrite(&entry, sizeof(EntryType), 1, file) == 1;
+      ++header.num_saved;
+    }
+  }
+
+  written = written &&
+    std::fseek(file, 0, SEEK_SET) == 0 &&
+    std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+  if (std::fclose(file) != 0 || !written)
+  {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+template <typename EntryType>
+void TT<EntryType>::load(const std::string& path)
+{
+  MappedFile file(path, MappedFile::Mode::COPY_ON_WRITE);
+  if (file.size() < sizeof(SnapshotHeader))
+  {
+    throw std::runtime_error(path + " is too small to be a table snapshot");
+  }
+
+  SnapshotHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  check_snapshot_header(header, path);
+
+  const std::uint8_t* body = file.data() + sizeof(SnapshotHeader);
+  const std::size_t body_size = file.size() - sizeof(SnapshotHeader);
+
+  if (!header.compact)
+  {
+    if (body_size != header.num_entries * sizeof(EntryType))
+    {
+      throw std::runtime_error(path + " is truncated");
+    }
+
+    private_entries_.clear();
+    private_entries_.shrink_to_fit();
+    shared_ = SharedMemory();
+    shared_name_.clear();
+    entries_ = reinterpret_cast<EntryType*>(file.writable_data() + sizeof(SnapshotHeader));
+    size_ = header.num_entries;
+    snapshot_ = std::move(file);
+    return;
+  }
+
+  constexpr std::size_t saved_size = sizeof(std::uint64_t) + sizeof(EntryType);
+  if (body_size != header.num_saved * saved_size)
+  {
+    throw std::runtime_error(path + " is truncated");
+  }
+
+  use_private_entries(header.num_entries);
+  clear();
+  for (std::uint64_t i = 0; i < header.num_saved; i++)
+  {
+    std::uint64_t index;
+    std::memcpy(&index, body + i * saved_size, sizeof(index));
+    if (index >= size_)
+    {
+      throw std::runtime_error(path + " is corrupt");
+    }
+
+    std::memcpy(
+      static_cast<void*>(&entries_[index]), body + i * saved_size + sizeof(index), sizeof(EntryType));
+  }
+}
+
+template <typename EntryType>
+bool TT<EntryType>::probe(std::uint64_t hash, EntryType** entry)
+{
+  *entry = slot(hash);
   return (*entry)->hash == hash;
 }
 
+template <typename EntryType>
+template <typename Predicate>
+int TT<EntryType>::hashfull(Predicate in_use) const
+{
+  const std::size_t sample_size = size_ < 1000 ? size_ : 1000;
+  double used = 0;
+  for (std::size_t i = 0; i < sample_size; i++)
+  {
+    used += in_use(entries_[i]);
+  }
+
+  return static_cast<int>(used * 1000 / sample_size);
+}
+
 }
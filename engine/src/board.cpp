@@ -1,11 +1,15 @@
 #include "engine/board.h"
+#include "engine/instrument.h"
 
 #include "eval.h"
 #include "keys.h"
+#include "nnue.h"
 
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cctype>
+#include <stdexcept>
 #include <vector>
 
 namespace
@@ -64,12 +68,65 @@ inline la::Move create(
 
 }
 
+namespace material
+{
+
+Key from_string(const std::string& pieces)
+{
+  Key key = 0;
+  Colour col = Colour::WHITE;
+  for (const char c : pieces)
+  {
+    switch (c)
+    {
+      case 'v': col = Colour::BLACK; break;
+      case 'P':
+        key += piece_key(col, col == Colour::WHITE ? PieceType::PAWN_WHITE : PieceType::PAWN_BLACK);
+        break;
+      case 'N': key += piece_key(col, PieceType::KNIGHT); break;
+      case 'R': key += piece_key(col, PieceType::ROOK); break;
+      case 'Q': key += piece_key(col, PieceType::QUEEN); break;
+      default: break;
+    }
+  }
+
+  return key;
+}
+
+std::string to_string(Key key)
+{
+  static constexpr std::array<std::pair<char, PieceType>, 4> pieces =
+  {
+    std::make_pair('Q', PieceType::QUEEN),
+    std::make_pair('R', PieceType::ROOK),
+    std::make_pair('N', PieceType::KNIGHT),
+    std::make_pair('P', PieceType::PAWN_WHITE)
+  };
+
+  std::string str;
+  for (const auto col : { Colour::WHITE, Colour::BLACK })
+  {
+    str += col == Colour::WHITE ? "K" : "vK";
+    for (const auto& [c, pt] : pieces)
+    {
+      const int count = (key / piece_key(col, pt)) & 0xF;
+      str += std::string(count, c);
+    }
+  }
+
+  return str;
+}
+
+}
+
 // Represent the board state using a "letter-box" style structure.
 class BoardImpl
 {
 public:
   BoardImpl();
+  explicit BoardImpl(const std::string&);
   std::vector<Move> get_moves(MoveGenType type) const;
+  void get_moves(std::vector<Move>&, MoveGenType type) const;
   std::vector<int> get_targets_for_piece(int, int) const;
   Colour player_to_move() const { return states_.back().player_to_move; }
   void make_move(Move);
@@ -77,20 +134,34 @@ public:
   void undo_move(Move);
   void make_null_move();
   void undo_null_move();
-  int score() const { return states_.back().score; }
+  int score() const;
   std::uint64_t hash() const { return states_.back().hash; }
+  material::Key material_key() const { return states_.back().material_key; }
+  std::uint64_t pawn_hash() const { return states_.back().pawn_hash; }
+  int king_location(Colour col) const
+  { return from_padded(states_.back().king_locations[static_cast<int>(col)]); }
   bool is_draw() const;
+  int halfmove_clock() const;
+  int game_ply() const { return static_cast<int>(states_.size()) - 1; }
   bool in_check() const;
   std::optional<Piece> get_piece(int, int) const;
   std::string move_to_string(Move) const;
+  std::string to_fen() const;
+
+  static CompactMove to_compact(Move);
+  Move from_compact(CompactMove) const;
 
 private:
+  static constexpr const char* start_fen = "rnqknr/pppppp/6/6/PPPPPP/RNQKNR w";
+
   // Keep track of state which changes per turn.
   struct BoardState
   {
     Colour player_to_move;
     int score;
     std::uint64_t hash;
+    material::Key material_key;
+    std::uint64_t pawn_hash; // The Zobrist hash of just the pawns.
     std::array<int, 2> king_locations;
     bool is_reversible; // Not a pawn move or capture.
   };
@@ -122,6 +193,12 @@ private:
   mutable std::array<Square, padded_board_area> squares_;
   std::vector<BoardState> states_;
 
+  // Plies since the last pawn move or capture when the position was set up.
+  int initial_halfmove_clock_ = 0;
+
+  // When a network is loaded there is an accumulator for each state.
+  mutable std::vector<nnue::Accumulator> accumulators_;
+
   static constexpr int to_padded(int r, int c)
   {
     return (r + 2) * padded_board_side + c + 2;
@@ -139,17 +216,37 @@ private:
     return (padded_row - 2) * board_side + padded_col - 2;
   }
 
+  template <Colour us>
   bool will_be_in_check(int, int) const;
-  void add_pawn_moves(int, std::vector<Move>&, la::MoveGenType) const;
+  template <Colour us, MoveGenType type>
+  void add_pawn_moves(int, std::vector<Move>&) const;
+  template <Colour us, MoveGenType type>
+  void generate_moves(std::vector<Move>&) const;
+
+  const nnue::Accumulator& current_accumulator() const;
+  void push_accumulator(Move);
 };
 
-BoardImpl::BoardImpl()
+BoardImpl::BoardImpl() : BoardImpl(start_fen)
+{
+}
+
+BoardImpl::BoardImpl(const std::string& fen)
 {
+  const auto invalid = [&fen] (const std::string& reason)
+  {
+    return std::invalid_argument("Invalid position \"" + fen + "\": " + reason);
+  };
+
   // Start off by marking all squares as being part of the padding.
   squares_.fill(0);
 
   int score = 0;
-  std::uint64_t hash = keys::white_key;
+  std::uint64_t hash = 0;
+  material::Key material_key = 0;
+  std::uint64_t pawn_hash = 0;
+  std::array<int, 2> king_locations = { 0, 0 };
+  std::array<int, 2> num_kings = { 0, 0 };
 
   const auto set_square_properties = [&] (int loc, Colour col, PieceType pt)
   {
@@ -163,6 +260,18 @@ BoardImpl::BoardImpl()
 
     score += col == Colour::WHITE ? piece_score : -piece_score;
     hash ^= keys::piece_square_keys[static_cast<int>(col)][static_cast<int>(pt)][loc];
+    material_key += material::piece_key(col, pt);
+
+    if (square::is_pawn(sq))
+    {
+      pawn_hash ^= keys::piece_square_keys[static_cast<int>(col)][static_cast<int>(pt)][loc];
+    }
+
+    if (pt == PieceType::KING)
+    {
+      king_locations[static_cast<int>(col)] = loc;
+      ++num_kings[static_cast<int>(col)];
+    }
   };
 
   // Make a pass where we mark squares that are on the board.
@@ -175,43 +284,110 @@ BoardImpl::BoardImpl()
     }
   }
 
-  // Now do the initial piece setup.
-  static constexpr std::array<PieceType, 6> backrank =
+  // The ranks are listed from the black side of the board, as in chess FEN.
+  int r = board_side - 1, c = 0;
+  std::size_t i = 0;
+  for (; i < fen.size() && fen[i] != ' '; i++)
   {
-    PieceType::ROOK,
-    PieceType::KNIGHT,
-    PieceType::QUEEN,
-    PieceType::KING,
-    PieceType::KNIGHT,
-    PieceType::ROOK
-  };
+    const char ch = fen[i];
+    if (ch == '/')
+    {
+      if (c != board_side) throw invalid("wrong number of squares in a rank");
+      --r;
+      c = 0;
+      continue;
+    }
+
+    if (r < 0) throw invalid("too many ranks");
+
+    if (ch >= '1' && ch <= '0' + board_side)
+    {
+      c += ch - '0';
+      if (c > board_side) throw invalid("wrong number of squares in a rank");
+      continue;
+    }
+
+    if (c >= board_side) throw invalid("wrong number of squares in a rank");
+
+    const Colour col = std::isupper(ch) ? Colour::WHITE : Colour::BLACK;
+    PieceType pt;
+    switch (std::tolower(ch))
+    {
+      case 'p': pt = col == Colour::WHITE ? PieceType::PAWN_WHITE : PieceType::PAWN_BLACK; break;
+      case 'n': pt = PieceType::KNIGHT; break;
+      case 'r': pt = PieceType::ROOK; break;
+      case 'q': pt = PieceType::QUEEN; break;
+      case 'k': pt = PieceType::KING; break;
+      default: throw invalid(std::string("unknown piece '") + ch + "'");
+    }
+
+    set_square_properties(to_padded(r, c++), col, pt);
+  }
 
-  for (int c = 0; c < 6; c++)
+  if (r != 0 || c != board_side) throw invalid("wrong number of squares");
+  if (num_kings[0] != 1 || num_kings[1] != 1) throw invalid("each side needs exactly one king");
+
+  Colour player_to_move = Colour::WHITE;
+  if (i + 1 < fen.size())
   {
-    set_square_properties(to_padded(0, c), Colour::WHITE, backrank[c]);
-    set_square_properties(to_padded(1, c), Colour::WHITE, PieceType::PAWN_WHITE);
-    set_square_properties(to_padded(4, c), Colour::BLACK, PieceType::PAWN_BLACK);
-    set_square_properties(to_padded(5, c), Colour::BLACK, backrank[c]);
+    switch (fen[i + 1])
+    {
+      case 'w': break;
+      case 'b': player_to_move = Colour::BLACK; break;
+      default: throw invalid("unknown side to move");
+    }
+  }
+
+  // The side to move can be followed by the halfmove clock.
+  constexpr const char* whitespace = " \t\r\n";
+  const auto clock_start = i + 2 < fen.size() ? fen.find_first_not_of(whitespace, i + 2) : fen.npos;
+  if (clock_start != fen.npos)
+  {
+    const auto clock = fen.substr(clock_start, fen.find_last_not_of(whitespace) + 1 - clock_start);
+    const auto is_digit = [] (unsigned char ch) { return std::isdigit(ch) != 0; };
+    if (clock.size() > 3 || !std::all_of(clock.begin(), clock.end(), is_digit))
+    {
+      throw invalid("malformed halfmove clock");
+    }
+
+    initial_halfmove_clock_ = std::stoi(clock);
+  }
+
+  if (player_to_move == Colour::WHITE)
+  {
+    hash ^= keys::white_key;
+  }
+  else
+  {
+    score = -score;
   }
 
   BoardState state =
   {
-    Colour::WHITE,
+    player_to_move,
     score,
     hash,
-    { to_padded(0, 3), to_padded(5, 3) },
+    material_key,
+    pawn_hash,
+    king_locations,
     false
   };
 
   states_.push_back(state);
 }
 
+template <Colour us>
 bool BoardImpl::will_be_in_check(int start, int end) const
 {
+  LA_COUNT(WILL_BE_IN_CHECK);
+  LA_TIME(WILL_BE_IN_CHECK);
+
+  static constexpr int pawn_offset = us == Colour::WHITE ? padded_board_side : -padded_board_side;
+
   bool in_check = false;
 
   const auto& state = states_.back();
-  int king_loc = state.king_locations[static_cast<int>(state.player_to_move)];
+  int king_loc = state.king_locations[static_cast<int>(us)];
   int left_pawn_loc, right_pawn_loc;
   const Square start_sq = squares_[start];
   const auto pt = square::get_pt(start_sq);
@@ -237,8 +413,7 @@ bool BoardImpl::will_be_in_check(int start, int end) const
       while (square::on_board(target_sq))
       {
         auto pt = square::get_pt(target_sq);
-        if (pt == target_pt &&
-            square::get_colour(target_sq) != state.player_to_move)
+        if (pt == target_pt && square::get_colour(target_sq) != us)
         {
           in_check = true;
           goto check_end;
@@ -252,25 +427,23 @@ bool BoardImpl::will_be_in_check(int start, int end) const
   }
 
   // Check for pawn checks.
-  left_pawn_loc = king_loc - 1;
-  left_pawn_loc += state.player_to_move == Colour::WHITE ?  padded_board_side : -padded_board_side;
+  left_pawn_loc = king_loc + pawn_offset - 1;
 
   target_sq = squares_[left_pawn_loc];
   if (square::on_board(target_sq) &&
       square::is_pawn(target_sq) &&
-      square::get_colour(target_sq) != state.player_to_move)
+      square::get_colour(target_sq) != us)
   {
     in_check = true;
     goto check_end;
   }
 
-  right_pawn_loc = king_loc + 1;
-  right_pawn_loc += state.player_to_move == Colour::WHITE ?  padded_board_side : -padded_board_side;
+  right_pawn_loc = king_loc + pawn_offset + 1;
 
   target_sq = squares_[right_pawn_loc];
   if (square::on_board(target_sq) &&
       square::is_pawn(target_sq) &&
-      square::get_colour(target_sq) != state.player_to_move)
+      square::get_colour(target_sq) != us)
   {
     in_check = true;
     goto check_end;
@@ -284,8 +457,17 @@ check_end:
   return in_check;
 }
 
-void BoardImpl::add_pawn_moves(int loc, std::vector<Move>& moves, la::MoveGenType type) const
+template <Colour us, MoveGenType type>
+void BoardImpl::add_pawn_moves(int loc, std::vector<Move>& moves) const
 {
+  static constexpr int forward_offset = us == Colour::WHITE ? padded_board_side : -padded_board_side;
+
+  // Pawns only ever move towards the opponent's back rank, so only one end of the board matters.
+  static constexpr auto is_promotion = [] (int target)
+  {
+    return us == Colour::WHITE ? target >= 7 * padded_board_side : target < 3 * padded_board_side;
+  };
+
   const auto add_promotions = [&moves] (const Move& move)
   {
     Move knight_promo(move);
@@ -299,69 +481,43 @@ void BoardImpl::add_pawn_moves(int loc, std::vector<Move>& moves, la::MoveGenTyp
     moves.push_back(queen_promo);
   };
 
-  const auto player_to_move = states_.back().player_to_move;
-
-  const int forward_offset =
-    player_to_move == Colour::WHITE ? padded_board_side : -padded_board_side;
-
   // Can we move forward to an empty location?
+  // Promotions are dynamic moves, so a quiet-only generation skips them entirely.
   const int forward = loc + forward_offset;
   Square target_sq = squares_[forward];
-  if (square::get_pt(target_sq) == PieceType::NONE && !will_be_in_check(loc, forward))
+  if (square::get_pt(target_sq) == PieceType::NONE)
   {
-    const auto move = move::create(loc, forward);
-    if (
-      (type & la::MoveGenType::DYNAMIC) &&
-      (forward < 3 * padded_board_side || forward >= 7 * padded_board_side))
+    if (is_promotion(forward))
     {
-      add_promotions(move);
+      if constexpr ((type & MoveGenType::DYNAMIC) != 0)
+      {
+        if (!will_be_in_check<us>(loc, forward)) add_promotions(move::create(loc, forward));
+      }
     }
-    else if (type & la::MoveGenType::QUIET)
+    else if constexpr ((type & MoveGenType::QUIET) != 0)
     {
-      moves.push_back(move);
+      if (!will_be_in_check<us>(loc, forward)) moves.push_back(move::create(loc, forward));
     }
   }
 
-  if (!(type & la::MoveGenType::DYNAMIC))
+  if constexpr ((type & MoveGenType::DYNAMIC) == 0)
   {
     return;
   }
 
   // Can we capture diagonally?
-  const int left_diag = forward - 1;
-  target_sq = squares_[left_diag];
-
-  if (target_sq & 0xFF)
+  for (const int target : { forward - 1, forward + 1 })
   {
-    auto pt = square::get_pt(target_sq);
-    if (pt != PieceType::NONE &&
-        square::get_colour(target_sq) != player_to_move &&
-        !will_be_in_check(loc, left_diag))
-    {
-      const auto move = move::create(loc, left_diag, pt);
-      if (left_diag < 3 * padded_board_side || left_diag >= 7 * padded_board_side)
-      {
-        add_promotions(move);
-      }
-      else
-      {
-        moves.push_back(move);
-      }
-    }
-  }
+    target_sq = squares_[target];
+    if (!square::on_board(target_sq)) continue;
 
-  const int right_diag = forward + 1;
-  target_sq = squares_[right_diag];
-
-  if (target_sq & 0xFF)
-  {
-    auto pt = square::get_pt(target_sq);
+    const auto pt = square::get_pt(target_sq);
     if (pt != PieceType::NONE &&
-        square::get_colour(target_sq) != player_to_move &&
-        !will_be_in_check(loc, right_diag))
+        square::get_colour(target_sq) != us &&
+        !will_be_in_check<us>(loc, target))
     {
-      const auto move = move::create(loc, right_diag, pt);
-      if (right_diag < 3 * padded_board_side || right_diag >= 7 * padded_board_side)
+      const auto move = move::create(loc, target, pt);
+      if (is_promotion(target))
       {
         add_promotions(move);
       }
@@ -373,16 +529,9 @@ void BoardImpl::add_pawn_moves(int loc, std::vector<Move>& moves, la::MoveGenTyp
   }
 }
 
-std::vector<Move> BoardImpl::get_moves(MoveGenType type) const
+template <Colour us, MoveGenType type>
+void BoardImpl::generate_moves(std::vector<Move>& moves) const
 {
-  std::vector<Move> moves;
-
-  if (is_draw())
-  {
-    return moves;
-  }
-
-  const auto player_to_move = states_.back().player_to_move;
   Square target_sq;
   for (int loc = 0; loc < padded_board_area; loc++)
   {
@@ -393,54 +542,96 @@ std::vector<Move> BoardImpl::get_moves(MoveGenType type) const
     if (pt == PieceType::NONE) continue; // Ignore empty locations.
 
     const auto colour = square::get_colour(sq);
-    if (colour != player_to_move) continue; // Ignore pieces of the wrong colour.
-
-    // Generate moves for this piece.
-    const auto& offsets = piece_offsets[static_cast<int>(pt)];
+    if (colour != us) continue; // Ignore pieces of the wrong colour.
 
     if (pt == PieceType::PAWN_WHITE || pt == PieceType::PAWN_BLACK)
     {
-      add_pawn_moves(loc, moves, type);
+      add_pawn_moves<us, type>(loc, moves);
+      continue;
     }
-    else
+
+    // Generate moves for this piece.
+    const auto& offsets = piece_offsets[static_cast<int>(pt)];
+    const bool is_slider = pt != PieceType::KNIGHT && pt != PieceType::KING;
+
+    for (const auto offset : offsets)
     {
-      for (const auto offset : offsets)
+      if (offset == 0) break;
+      int target = loc + offset;
+      target_sq = squares_[target];
+      while (square::on_board(target_sq))
       {
-        if (offset == 0) break;
-        int target = loc + offset;
-        target_sq = squares_[target];
-        while (square::on_board(target_sq))
+        if (square::get_pt(target_sq) != PieceType::NONE)
         {
-          if (square::get_pt(target_sq) != PieceType::NONE)
+          if constexpr ((type & MoveGenType::DYNAMIC) != 0)
           {
-            if ((type & la::MoveGenType::DYNAMIC) && square::get_colour(target_sq) != player_to_move)
+            if (square::get_colour(target_sq) != us && !will_be_in_check<us>(loc, target))
             {
               // Capture move.
-              if (will_be_in_check(loc, target)) break;
               moves.push_back(move::create(loc, target, square::get_pt(target_sq)));
             }
-
-            break;
           }
 
-          // Potential quiet move.
-          if ((type & la::MoveGenType::QUIET) && !will_be_in_check(loc, target))
+          break;
+        }
+
+        // Potential quiet move.
+        if constexpr ((type & MoveGenType::QUIET) != 0)
+        {
+          if (!will_be_in_check<us>(loc, target))
           {
             moves.push_back(move::create(loc, target));
           }
+        }
 
-          if (pt == PieceType::KNIGHT || pt == PieceType::KING) break;
+        if (!is_slider) break;
 
-          target += offset;
-          target_sq = squares_[target];
-        }
+        target += offset;
+        target_sq = squares_[target];
       }
     }
   }
+}
 
+std::vector<Move> BoardImpl::get_moves(MoveGenType type) const
+{
+  std::vector<Move> moves;
+  get_moves(moves, type);
   return moves;
 }
 
+void BoardImpl::get_moves(std::vector<Move>& moves, MoveGenType type) const
+{
+  LA_COUNT(GET_MOVES);
+  LA_TIME(GET_MOVES);
+
+  moves.clear();
+
+  if (is_draw())
+  {
+    return;
+  }
+
+  // Dispatch once to the generator specialised for this side and generation type, so that the
+  // inner loops never need to branch on either.
+  const bool white = player_to_move() == Colour::WHITE;
+  switch (type)
+  {
+    case MoveGenType::QUIET:
+      white ? generate_moves<Colour::WHITE, MoveGenType::QUIET>(moves)
+            : generate_moves<Colour::BLACK, MoveGenType::QUIET>(moves);
+      break;
+    case MoveGenType::DYNAMIC:
+      white ? generate_moves<Colour::WHITE, MoveGenType::DYNAMIC>(moves)
+            : generate_moves<Colour::BLACK, MoveGenType::DYNAMIC>(moves);
+      break;
+    case MoveGenType::ALL:
+      white ? generate_moves<Colour::WHITE, MoveGenType::ALL>(moves)
+            : generate_moves<Colour::BLACK, MoveGenType::ALL>(moves);
+      break;
+  }
+}
+
 std::vector<int> BoardImpl::get_targets_for_piece(int row, int col) const
 {
   int loc = to_padded(row, col);
@@ -465,8 +656,79 @@ std::vector<int> BoardImpl::get_targets_for_piece(int row, int col) const
   return targets;
 }
 
+// The accumulator stack falls behind the states if the network is loaded after the board is set
+// up, so any missing accumulator is recomputed when it's needed.
+const nnue::Accumulator& BoardImpl::current_accumulator() const
+{
+  if (accumulators_.size() != states_.size())
+  {
+    accumulators_.resize(states_.size());
+  }
+
+  auto& acc = accumulators_.back();
+  if (!acc.valid)
+  {
+    nnue::reset(acc);
+    for (int loc = 0; loc < board_side * board_side; loc++)
+    {
+      const Square sq = squares_[to_padded(loc)];
+      const auto pt = square::get_pt(sq);
+      if (pt != PieceType::NONE)
+      {
+        nnue::add_feature(acc, square::get_colour(sq), pt, loc);
+      }
+    }
+  }
+
+  return acc;
+}
+
+// Push the accumulator for the position after the move. This must happen before the move is made.
+void BoardImpl::push_accumulator(Move move)
+{
+  nnue::Accumulator next = current_accumulator();
+
+  const auto player_to_move = states_.back().player_to_move;
+  const auto other_player = player_to_move == Colour::WHITE ? Colour::BLACK : Colour::WHITE;
+
+  const int start = move::get_start(move);
+  const int end = move::get_end(move);
+  const auto moving_piece_type = square::get_pt(squares_[start]);
+  const auto cap_piece_type = move::get_cap(move);
+  const auto promo_type = move::get_promo(move);
+
+  nnue::remove_feature(next, player_to_move, moving_piece_type, from_padded(start));
+  nnue::add_feature(
+    next,
+    player_to_move,
+    promo_type != PieceType::NONE ? promo_type : moving_piece_type,
+    from_padded(end));
+
+  if (cap_piece_type != PieceType::NONE)
+  {
+    nnue::remove_feature(next, other_player, cap_piece_type, from_padded(end));
+  }
+
+  accumulators_.push_back(next);
+}
+
+int BoardImpl::score() const
+{
+  return nnue::loaded()
+    ? nnue::evaluate(current_accumulator(), player_to_move())
+    : states_.back().score;
+}
+
 void BoardImpl::make_move(Move move)
 {
+  LA_COUNT(MAKE_MOVE);
+  LA_TIME(MAKE_MOVE);
+
+  if (nnue::loaded())
+  {
+    push_accumulator(move);
+  }
+
   const auto& prev_state = states_.back();
   auto next_state = prev_state;
 
@@ -474,7 +736,7 @@ void BoardImpl::make_move(Move move)
   const auto other_player = player_to_move == Colour::WHITE ? Colour::BLACK : Colour::WHITE;
 
   int next_score = prev_state.score;
-  int next_hash = prev_state.hash ^ keys::white_key;
+  std::uint64_t next_hash = prev_state.hash ^ keys::white_key;
 
   const int start = move::get_start(move);
   const int end = move::get_end(move);
@@ -491,6 +753,15 @@ void BoardImpl::make_move(Move move)
   next_hash ^= keys::piece_square_keys
       [static_cast<int>(player_to_move)][static_cast<int>(moving_piece_type)][start];
 
+  const bool pawn_moved =
+    moving_piece_type == PieceType::PAWN_WHITE || moving_piece_type == PieceType::PAWN_BLACK;
+
+  if (pawn_moved)
+  {
+    next_state.pawn_hash ^= keys::piece_square_keys
+        [static_cast<int>(player_to_move)][static_cast<int>(moving_piece_type)][start];
+  }
+
   const auto promo_type = move::get_promo(move);
   if (promo_type != PieceType::NONE)
   {
@@ -502,6 +773,9 @@ void BoardImpl::make_move(Move move)
     next_hash ^= keys::piece_square_keys
         [static_cast<int>(player_to_move)][static_cast<int>(promo_type)][end];
 
+    next_state.material_key -= material::piece_key(player_to_move, moving_piece_type);
+    next_state.material_key += material::piece_key(player_to_move, promo_type);
+
     square::set_pt(end_sq, promo_type);
   }
   else
@@ -511,6 +785,12 @@ void BoardImpl::make_move(Move move)
     next_hash ^= keys::piece_square_keys
         [static_cast<int>(player_to_move)][static_cast<int>(moving_piece_type)][end];
 
+    if (pawn_moved)
+    {
+      next_state.pawn_hash ^= keys::piece_square_keys
+          [static_cast<int>(player_to_move)][static_cast<int>(moving_piece_type)][end];
+    }
+
     square::set_pt(end_sq, moving_piece_type);
   }
 
@@ -522,6 +802,14 @@ void BoardImpl::make_move(Move move)
 
     next_hash ^= keys::piece_square_keys
         [static_cast<int>(other_player)][static_cast<int>(cap_piece_type)][end];
+
+    next_state.material_key -= material::piece_key(other_player, cap_piece_type);
+
+    if (cap_piece_type == PieceType::PAWN_WHITE || cap_piece_type == PieceType::PAWN_BLACK)
+    {
+      next_state.pawn_hash ^= keys::piece_square_keys
+          [static_cast<int>(other_player)][static_cast<int>(cap_piece_type)][end];
+    }
   }
 
   if (moving_piece_type == PieceType::KING)
@@ -533,10 +821,7 @@ void BoardImpl::make_move(Move move)
   next_state.score = -1 * next_score;
   next_state.hash = next_hash;
 
-  next_state.is_reversible =
-    moving_piece_type != PieceType::PAWN_WHITE &&
-    moving_piece_type != PieceType::PAWN_BLACK &&
-    cap_piece_type == PieceType::NONE;
+  next_state.is_reversible = !pawn_moved && cap_piece_type == PieceType::NONE;
 
   states_.push_back(next_state);
 }
@@ -557,12 +842,25 @@ void BoardImpl::make_null_move()
   next_state.score *= -1;
   next_state.hash ^= keys::white_key;
   next_state.is_reversible = true;
+
+  if (nnue::loaded())
+  {
+    // Passing doesn't move any pieces.
+    const auto acc = current_accumulator();
+    accumulators_.push_back(acc);
+  }
+
   states_.push_back(next_state);
 }
 
 void BoardImpl::undo_null_move()
 {
   states_.pop_back();
+
+  if (accumulators_.size() > states_.size())
+  {
+    accumulators_.pop_back();
+  }
 }
 
 void BoardImpl::undo_move(Move move)
@@ -570,6 +868,11 @@ void BoardImpl::undo_move(Move move)
   const auto other_player = states_.back().player_to_move;
   states_.pop_back();
 
+  if (accumulators_.size() > states_.size())
+  {
+    accumulators_.pop_back();
+  }
+
   const auto player_to_move = other_player == Colour::WHITE ? Colour::BLACK : Colour::WHITE;
 
   const int start = move::get_start(move);
@@ -585,7 +888,7 @@ void BoardImpl::undo_move(Move move)
   const auto promo_type = move::get_promo(move);
   if (promo_type != PieceType::NONE)
   {
-    if (other_player == Colour::WHITE)
+    if (player_to_move == Colour::WHITE)
     {
       square::set_pt(start_sq, PieceType::PAWN_WHITE);
     }
@@ -613,7 +916,9 @@ void BoardImpl::undo_move(Move move)
 bool BoardImpl::in_check() const
 {
   // Call `will_be_in_check` with a dummy move.
-  return will_be_in_check(0, 0);
+  return player_to_move() == Colour::WHITE
+    ? will_be_in_check<Colour::WHITE>(0, 0)
+    : will_be_in_check<Colour::BLACK>(0, 0);
 }
 
 bool BoardImpl::is_draw() const
@@ -621,7 +926,7 @@ bool BoardImpl::is_draw() const
   // Check for draw by repetition.
   int num_repeats = 0;
   const auto current_hash = states_.back().hash;
-  for (int i = static_cast<int>(states_.size()); i >= 0; i--)
+  for (int i = static_cast<int>(states_.size()) - 1; i >= 0; i--)
   {
     const auto& state = states_[i];
     num_repeats += (state.hash == current_hash);
@@ -630,6 +935,20 @@ bool BoardImpl::is_draw() const
   return num_repeats == 3;
 }
 
+int BoardImpl::halfmove_clock() const
+{
+  // The first state is the set up position, which has no move leading to it.
+  int plies = 0;
+  std::size_t i = states_.size() - 1;
+  for (; i > 0 && states_[i].is_reversible; i--)
+  {
+    ++plies;
+  }
+
+  // The clock carries on from the set up position if nothing since has reset it.
+  return i == 0 ? initial_halfmove_clock_ + plies : plies;
+}
+
 std::optional<Piece> BoardImpl::get_piece(int row, int col) const
 {
   assert(row >= 0 && row < board_side && col >= 0 && col < board_side);
@@ -647,6 +966,49 @@ std::optional<Piece> BoardImpl::get_piece(int row, int col) const
   return Piece { static_cast<Colour>(colour), static_cast<PieceType>(pt) };
 }
 
+namespace
+{
+
+// The promotions in the order of their compact codes, after none.
+constexpr PieceType compact_promotions[] = { PieceType::KNIGHT, PieceType::ROOK, PieceType::QUEEN };
+
+}
+
+CompactMove BoardImpl::to_compact(Move move)
+{
+  if (move == 0)
+  {
+    return 0;
+  }
+
+  const auto promo = move::get_promo(move);
+  int promo_code = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    promo_code = compact_promotions[i] == promo ? i + 1 : promo_code;
+  }
+
+  return static_cast<CompactMove>(
+    from_padded(move::get_start(move)) |
+    from_padded(move::get_end(move)) << 6 |
+    promo_code << 12);
+}
+
+Move BoardImpl::from_compact(CompactMove compact) const
+{
+  if (compact == 0)
+  {
+    return 0;
+  }
+
+  const int start = to_padded(compact & 0x3F);
+  const int end = to_padded((compact >> 6) & 0x3F);
+  const int promo_code = (compact >> 12) & 0x3;
+  const auto cap = square::get_pt(squares_[end]);
+  const auto promo = promo_code > 0 ? compact_promotions[promo_code - 1] : PieceType::NONE;
+  return move::create(start, end, cap, promo);
+}
+
 // Serialise a move given the current position.
 std::string BoardImpl::move_to_string(Move move) const
 {
@@ -685,10 +1047,64 @@ std::string BoardImpl::move_to_string(Move move) const
   return move_str;
 }
 
+std::string BoardImpl::to_fen() const
+{
+  static constexpr const char* piece_chars = " PPNRQK";
+
+  std::string fen;
+  for (int r = board_side - 1; r >= 0; r--)
+  {
+    int num_empty = 0;
+    for (int c = 0; c < board_side; c++)
+    {
+      const Square sq = squares_[to_padded(r, c)];
+      const auto pt = square::get_pt(sq);
+      if (pt == PieceType::NONE)
+      {
+        ++num_empty;
+        continue;
+      }
+
+      if (num_empty > 0)
+      {
+        fen += static_cast<char>('0' + num_empty);
+        num_empty = 0;
+      }
+
+      const char ch = piece_chars[static_cast<int>(pt)];
+      fen += square::get_colour(sq) == Colour::WHITE ? ch : static_cast<char>(std::tolower(ch));
+    }
+
+    if (num_empty > 0)
+    {
+      fen += static_cast<char>('0' + num_empty);
+    }
+
+    if (r > 0)
+    {
+      fen += '/';
+    }
+  }
+
+  fen += player_to_move() == Colour::WHITE ? " w" : " b";
+
+  const int clock = halfmove_clock();
+  if (clock > 0)
+  {
+    fen += " " + std::to_string(clock);
+  }
+
+  return fen;
+}
+
 Board::Board() : impl_(std::make_unique<BoardImpl>())
 {
 }
 
+Board::Board(const std::string& fen) : impl_(std::make_unique<BoardImpl>(fen))
+{
+}
+
 Board::Board(const Board& other) : impl_(std::make_unique<BoardImpl>(*other.impl_))
 {
 }
@@ -711,6 +1127,11 @@ std::vector<Move> Board::get_moves(MoveGenType type) const
   return impl_->get_moves(type);
 }
 
+void Board::get_moves(std::vector<Move>& moves, MoveGenType type) const
+{
+  impl_->get_moves(moves, type);
+}
+
 std::vector<int> Board::get_targets_for_piece(int row, int col) const
 {
   return impl_->get_targets_for_piece(row, col);
@@ -751,6 +1172,31 @@ std::uint64_t Board::hash() const
   return impl_->hash();
 }
 
+std::uint64_t Board::pawn_hash() const
+{
+  return impl_->pawn_hash();
+}
+
+material::Key Board::material_key() const
+{
+  return impl_->material_key();
+}
+
+int Board::king_location(Colour col) const
+{
+  return impl_->king_location(col);
+}
+
+int Board::halfmove_clock() const
+{
+  return impl_->halfmove_clock();
+}
+
+int Board::game_ply() const
+{
+  return impl_->game_ply();
+}
+
 bool Board::is_draw() const
 {
   return impl_->is_draw();
@@ -766,9 +1212,24 @@ std::optional<Piece> Board::get_piece(int row, int col) const
   return impl_->get_piece(row, col);
 }
 
+Move Board::from_compact(CompactMove compact) const
+{
+  return impl_->from_compact(compact);
+}
+
+CompactMove move::to_compact(Move move)
+{
+  return BoardImpl::to_compact(move);
+}
+
 std::string Board::move_to_string(Move move) const
 {
   return impl_->move_to_string(move);
 }
 
+std::string Board::to_fen() const
+{
+  return impl_->to_fen();
+}
+
 }
@@ -0,0 +1,62 @@
+#include "engine/book.h"
+#include "engine/records.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+
+std::unique_ptr<la::RecordReader<la::book::Entry>> entries;
+
+}
+
+namespace la::book
+{
+
+std::size_t init(const std::string& path)
+{
+  auto reader = std::make_unique<RecordReader<Entry>>(path);
+  if (!std::is_sorted(reader->begin(), reader->end(), [] (const Entry& lhs, const Entry& rhs)
+  {
+    return lhs.hash < rhs.hash;
+  }))
+  {
+    throw std::runtime_error(path + " is not sorted by hash");
+  }
+
+  entries = std::move(reader);
+  return entries->size();
+}
+
+std::optional<Entry> probe(const Board& board)
+{
+  if (!entries)
+  {
+    return std::nullopt;
+  }
+
+  const auto hash = board.hash();
+  const auto it = std::lower_bound(entries->begin(), entries->end(), hash,
+    [] (const Entry& entry, std::uint64_t hash)
+    {
+      return entry.hash < hash;
+    });
+
+  if (it == entries->end() || it->hash != hash)
+  {
+    return std::nullopt;
+  }
+
+  // Guard against hash collisions.
+  const auto moves = board.get_moves();
+  if (std::find(moves.begin(), moves.end(), it->move) == moves.end())
+  {
+    return std::nullopt;
+  }
+
+  return *it;
+}
+
+}
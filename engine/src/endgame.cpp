@@ -0,0 +1,128 @@
+#include "engine/endgame.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+namespace
+{
+
+using la::Colour;
+
+int distance_to_edge(int loc)
+{
+  const int row = loc / la::board_side, col = loc % la::board_side;
+  return std::min(
+    std::min(row, la::board_side - 1 - row),
+    std::min(col, la::board_side - 1 - col));
+}
+
+int king_distance(int loc1, int loc2)
+{
+  return std::max(
+    std::abs(loc1 / la::board_side - loc2 / la::board_side),
+    std::abs(loc1 % la::board_side - loc2 % la::board_side));
+}
+
+// A major piece against a lone king: drive the defending king to the edge and bring the attacking
+// king closer to help mate it.
+template <Colour strong_side>
+int evaluate_kxk(const la::Board& board)
+{
+  constexpr Colour weak_side = strong_side == Colour::WHITE ? Colour::BLACK : Colour::WHITE;
+
+  const int strong_king = board.king_location(strong_side);
+  const int weak_king = board.king_location(weak_side);
+
+  const int score =
+    la::endgame::known_win_score +
+    100 * (la::board_side / 2 - distance_to_edge(weak_king)) +
+    20 * (la::board_side - king_distance(strong_king, weak_king));
+
+  return board.player_to_move() == strong_side ? score : -score;
+}
+
+// The table is indexed by material key. It is much larger than the number of recognisers so
+// collisions are rare, and those there are get resolved by linear probing.
+class RecogniserTable
+{
+public:
+  RecogniserTable();
+  const la::endgame::Recogniser* probe(la::material::Key) const;
+
+private:
+  static constexpr std::size_t table_size = 256;
+
+  std::array<la::endgame::Recogniser, table_size> recognisers_;
+  std::array<bool, table_size> occupied_;
+
+  static std::size_t index(la::material::Key key)
+  {
+    return (key * 0x9E3779B1u) >> 24;
+  }
+
+  void add(const char*, la::endgame::RecogniserType, int (*)(const la::Board&) = nullptr);
+};
+
+RecogniserTable::RecogniserTable()
+{
+  occupied_.fill(false);
+
+  using la::endgame::RecogniserType;
+
+  // Neither side has enough material to force mate, although a mate can still be blundered into
+  // with a knight on the board.
+  add("KvK", RecogniserType::DRAW);
+  add("KNvK", RecogniserType::DRAW);
+  add("KvKN", RecogniserType::DRAW);
+  add("KNvKN", RecogniserType::DRAW);
+
+  // Trivial wins which still need to be played out.
+  add("KQvK", RecogniserType::EVALUATE, evaluate_kxk<Colour::WHITE>);
+  add("KRvK", RecogniserType::EVALUATE, evaluate_kxk<Colour::WHITE>);
+  add("KvKQ", RecogniserType::EVALUATE, evaluate_kxk<Colour::BLACK>);
+  add("KvKR", RecogniserType::EVALUATE, evaluate_kxk<Colour::BLACK>);
+}
+
+void RecogniserTable::add(
+  const char* pieces,
+  la::endgame::RecogniserType type,
+  int (*evaluate)(const la::Board&))
+{
+  const auto key = la::material::from_string(pieces);
+  std::size_t i = index(key);
+  while (occupied_[i])
+  {
+    i = (i + 1) % table_size;
+  }
+
+  recognisers_[i] = { key, type, evaluate };
+  occupied_[i] = true;
+}
+
+const la::endgame::Recogniser* RecogniserTable::probe(la::material::Key key) const
+{
+  for (std::size_t i = index(key); occupied_[i]; i = (i + 1) % table_size)
+  {
+    if (recognisers_[i].key == key)
+    {
+      return &recognisers_[i];
+    }
+  }
+
+  return nullptr;
+}
+
+const RecogniserTable recogniser_table;
+
+}
+
+namespace la::endgame
+{
+
+const Recogniser* probe(const Board& board)
+{
+  return recogniser_table.probe(board.material_key());
+}
+
+}
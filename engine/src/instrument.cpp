@@ -0,0 +1,101 @@
+#include "engine/instrument.h"
+
+#include <cstdio>
+#include <iterator>
+#include <mutex>
+
+namespace
+{
+
+thread_local la::instrument::Stats stats;
+
+std::mutex totals_mutex;
+la::instrument::Stats total_stats;
+
+constexpr const char* counter_names[] =
+{
+  "get_moves",
+  "will_be_in_check",
+  "make_move",
+  "tt_probe",
+  "tt_hit",
+  "tt_store",
+  "quiesce",
+  "null_move_attempt",
+  "null_move_cutoff"
+};
+
+constexpr const char* timer_names[] =
+{
+  "get_moves",
+  "will_be_in_check",
+  "make_move"
+};
+
+static_assert(std::size(counter_names) == static_cast<std::size_t>(la::instrument::Counter::NUM_COUNTERS));
+static_assert(std::size(timer_names) == static_cast<std::size_t>(la::instrument::Timer::NUM_TIMERS));
+
+}
+
+namespace la::instrument
+{
+
+void Stats::add(const Stats& other)
+{
+  for (std::size_t i = 0; i < counters.size(); i++) counters[i] += other.counters[i];
+  for (std::size_t i = 0; i < cycles.size(); i++) cycles[i] += other.cycles[i];
+  for (std::size_t i = 0; i < cutoffs.size(); i++) cutoffs[i] += other.cutoffs[i];
+}
+
+Stats& thread_stats()
+{
+  return stats;
+}
+
+void aggregate()
+{
+  std::lock_guard<std::mutex> lock(totals_mutex);
+  total_stats.add(stats);
+  stats = Stats();
+}
+
+Stats totals()
+{
+  std::lock_guard<std::mutex> lock(totals_mutex);
+  return total_stats;
+}
+
+void reset()
+{
+  std::lock_guard<std::mutex> lock(totals_mutex);
+  total_stats = Stats();
+}
+
+std::string to_string(const Stats& s)
+{
+  std::string str;
+  char line[128];
+  for (std::size_t i = 0; i < s.counters.size(); i++)
+  {
+    std::snprintf(line, sizeof(line), "%-20s %15lu\n", counter_names[i], s.counters[i]);
+    str += line;
+  }
+
+  for (std::size_t i = 0; i < s.cycles.size(); i++)
+  {
+    if (s.cycles[i] == 0) continue;
+    std::snprintf(line, sizeof(line), "%-20s %15lu cycles (inclusive)\n", timer_names[i], s.cycles[i]);
+    str += line;
+  }
+
+  for (std::size_t i = 0; i < s.cutoffs.size(); i++)
+  {
+    std::snprintf(line, sizeof(line), "cutoffs at move %zu%s %15lu\n",
+      i, i + 1 == s.cutoffs.size() ? "+" : " ", s.cutoffs[i]);
+    str += line;
+  }
+
+  return str;
+}
+
+}
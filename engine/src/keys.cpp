@@ -47,6 +47,30 @@ keys::keys()
   }
 }
 
+std::uint64_t zobrist_fingerprint()
+{
+  // FNV-1a over the keys.
+  std::uint64_t fingerprint = 0xCBF29CE484222325;
+  const auto add = [&fingerprint] (std::uint64_t key)
+  {
+    fingerprint = (fingerprint ^ key) * 0x100000001B3;
+  };
+
+  add(keys::white_key);
+  for (const auto& colour_keys : keys::piece_square_keys)
+  {
+    for (const auto& piece_keys : colour_keys)
+    {
+      for (const auto key : piece_keys)
+      {
+        add(key);
+      }
+    }
+  }
+
+  return fingerprint;
+}
+
 }
 
 namespace
@@ -0,0 +1,84 @@
+#include "engine/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace la
+{
+
+MappedFile::MappedFile(const std::string& path, Mode mode)
+  : writable_(mode == Mode::COPY_ON_WRITE)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw std::runtime_error("Failed to open " + path);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    throw std::runtime_error("Failed to stat " + path);
+  }
+
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ > 0)
+  {
+    void* addr = writable_
+      ? mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+      : mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+      close(fd);
+      throw std::runtime_error("Failed to map " + path);
+    }
+
+    data_ = static_cast<std::uint8_t*>(addr);
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+  : data_(std::exchange(other.data_, nullptr)),
+    size_(std::exchange(other.size_, 0)),
+    writable_(std::exchange(other.writable_, false))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+  if (this != &other)
+  {
+    unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    writable_ = std::exchange(other.writable_, false);
+  }
+
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  unmap();
+}
+
+void MappedFile::unmap()
+{
+  if (data_ != nullptr)
+  {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+}
@@ -0,0 +1,262 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+using namespace la::nnue;
+
+struct Network
+{
+  alignas(32) std::int16_t ft_weights[num_features][ft_size];
+  alignas(32) std::int16_t ft_biases[ft_size];
+  alignas(32) std::int16_t l1_weights[l1_size][2 * ft_size];
+  alignas(32) std::int32_t l1_biases[l1_size];
+  alignas(32) std::int16_t out_weights[l1_size];
+  std::int32_t out_bias;
+};
+
+Network network;
+bool network_loaded = false;
+
+int piece_index(la::PieceType pt)
+{
+  switch (pt)
+  {
+    case la::PieceType::PAWN_WHITE:
+    case la::PieceType::PAWN_BLACK: return 0;
+    case la::PieceType::KNIGHT:     return 1;
+    case la::PieceType::ROOK:       return 2;
+    case la::PieceType::QUEEN:      return 3;
+    default:                        return 4;
+  }
+}
+
+int feature_index(la::Colour perspective, la::Colour col, la::PieceType pt, int loc)
+{
+  // Black sees the board upside down.
+  if (perspective == la::Colour::BLACK)
+  {
+    loc = (la::board_side - 1 - loc / la::board_side) * la::board_side + loc % la::board_side;
+  }
+
+  const int relative_colour = col == perspective ? 0 : 1;
+  return (relative_colour * num_piece_kinds + piece_index(pt)) * num_squares + loc;
+}
+
+// Kernels. The AVX2 and SSE2 versions process 16 and 8 int16 lanes at a time, and the scalar
+// versions are used when neither instruction set is available.
+
+void add_column(std::int16_t* acc, const std::int16_t* weights)
+{
+#if defined(__AVX2__)
+  for (int i = 0; i < ft_size; i += 16)
+  {
+    auto* a = reinterpret_cast<__m256i*>(acc + i);
+    const auto* w = reinterpret_cast<const __m256i*>(weights + i);
+    _mm256_store_si256(a, _mm256_add_epi16(_mm256_load_si256(a), _mm256_load_si256(w)));
+  }
+#elif defined(__SSE2__)
+  for (int i = 0; i < ft_size; i += 8)
+  {
+    auto* a = reinterpret_cast<__m128i*>(acc + i);
+    const auto* w = reinterpret_cast<const __m128i*>(weights + i);
+    _mm_store_si128(a, _mm_add_epi16(_mm_load_si128(a), _mm_load_si128(w)));
+  }
+#else
+  for (int i = 0; i < ft_size; i++) acc[i] += weights[i];
+#endif
+}
+
+void subtract_column(std::int16_t* acc, const std::int16_t* weights)
+{
+#if defined(__AVX2__)
+  for (int i = 0; i < ft_size; i += 16)
+  {
+    auto* a = reinterpret_cast<__m256i*>(acc + i);
+    const auto* w = reinterpret_cast<const __m256i*>(weights + i);
+    _mm256_store_si256(a, _mm256_sub_epi16(_mm256_load_si256(a), _mm256_load_si256(w)));
+  }
+#elif defined(__SSE2__)
+  for (int i = 0; i < ft_size; i += 8)
+  {
+    auto* a = reinterpret_cast<__m128i*>(acc + i);
+    const auto* w = reinterpret_cast<const __m128i*>(weights + i);
+    _mm_store_si128(a, _mm_sub_epi16(_mm_load_si128(a), _mm_load_si128(w)));
+  }
+#else
+  for (int i = 0; i < ft_size; i++) acc[i] -= weights[i];
+#endif
+}
+
+// Clip the accumulator values to the activation range.
+void clipped_relu(const std::int16_t* in, std::int16_t* out, int size)
+{
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max = _mm256_set1_epi16(activation_max);
+  for (int i = 0; i < size; i += 16)
+  {
+    const __m256i x = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i));
+    _mm256_store_si256(
+      reinterpret_cast<__m256i*>(out + i), _mm256_min_epi16(_mm256_max_epi16(x, zero), max));
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max = _mm_set1_epi16(activation_max);
+  for (int i = 0; i < size; i += 8)
+  {
+    const __m128i x = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_store_si128(
+      reinterpret_cast<__m128i*>(out + i), _mm_min_epi16(_mm_max_epi16(x, zero), max));
+  }
+#else
+  for (int i = 0; i < size; i++)
+  {
+    out[i] = std::clamp<std::int16_t>(in[i], 0, activation_max);
+  }
+#endif
+}
+
+std::int32_t dot(const std::int16_t* a, const std::int16_t* b, int size)
+{
+#if defined(__AVX2__)
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < size; i += 16)
+  {
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(a + i)),
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(b + i))));
+  }
+
+  __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+  return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE2__)
+  __m128i sum = _mm_setzero_si128();
+  for (int i = 0; i < size; i += 8)
+  {
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(a + i)),
+      _mm_load_si128(reinterpret_cast<const __m128i*>(b + i))));
+  }
+
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+#else
+  std::int32_t sum = 0;
+  for (int i = 0; i < size; i++) sum += a[i] * b[i];
+  return sum;
+#endif
+}
+
+}
+
+namespace la::nnue
+{
+
+void load(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("Failed to open network " + path);
+  }
+
+  FileHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+  if (!file ||
+      std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+      header.version != file_version ||
+      header.ft_size != ft_size ||
+      header.l1_size != l1_size)
+  {
+    throw std::runtime_error("Invalid network " + path);
+  }
+
+  const auto read = [&file] (auto& data)
+  {
+    file.read(reinterpret_cast<char*>(&data), sizeof(data));
+  };
+
+  read(network.ft_weights);
+  read(network.ft_biases);
+  read(network.l1_weights);
+  read(network.l1_biases);
+  read(network.out_weights);
+  read(network.out_bias);
+
+  if (!file)
+  {
+    throw std::runtime_error("Truncated network " + path);
+  }
+
+  network_loaded = true;
+}
+
+bool loaded()
+{
+  return network_loaded;
+}
+
+void add_feature(Accumulator& acc, Colour col, PieceType pt, int loc)
+{
+  for (const auto perspective : { Colour::WHITE, Colour::BLACK })
+  {
+    add_column(
+      acc.values[static_cast<int>(perspective)].data(),
+      network.ft_weights[feature_index(perspective, col, pt, loc)]);
+  }
+}
+
+void remove_feature(Accumulator& acc, Colour col, PieceType pt, int loc)
+{
+  for (const auto perspective : { Colour::WHITE, Colour::BLACK })
+  {
+    subtract_column(
+      acc.values[static_cast<int>(perspective)].data(),
+      network.ft_weights[feature_index(perspective, col, pt, loc)]);
+  }
+}
+
+void reset(Accumulator& acc)
+{
+  for (auto& values : acc.values)
+  {
+    std::copy(std::begin(network.ft_biases), std::end(network.ft_biases), values.begin());
+  }
+
+  acc.valid = true;
+}
+
+int evaluate(const Accumulator& acc, Colour player_to_move)
+{
+  alignas(32) std::int16_t input[2 * ft_size];
+  alignas(32) std::int16_t hidden[l1_size];
+
+  const Colour other_player = player_to_move == Colour::WHITE ? Colour::BLACK : Colour::WHITE;
+  clipped_relu(acc.values[static_cast<int>(player_to_move)].data(), input, ft_size);
+  clipped_relu(acc.values[static_cast<int>(other_player)].data(), input + ft_size, ft_size);
+
+  for (int i = 0; i < l1_size; i++)
+  {
+    const std::int32_t sum = network.l1_biases[i] + dot(input, network.l1_weights[i], 2 * ft_size);
+    hidden[i] = static_cast<std::int16_t>(std::clamp(sum >> l1_shift, 0, activation_max));
+  }
+
+  const std::int32_t output = network.out_bias + dot(hidden, network.out_weights, l1_size);
+  return output / output_scale;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "engine/board.h"
+#include "engine/nnue.h"
+
+#include <array>
+#include <cstdint>
+
+// The network has one input for each (colour, piece, square) combination, seen from the
+// perspective of each player: the board is mirrored for black so that "own" pieces always
+// advance up the board.
+//
+// Input (360) -> Feature transformer (128 per perspective) -> L1 (32) -> Output (1)
+//
+// The feature transformer's output for each perspective is kept in an accumulator which is
+// updated incrementally as pieces move. The side to move's half comes first when the two halves
+// are concatenated. Activations are clipped to [0, 127] and L1 outputs are scaled down by 64.
+// The final output is divided by 16 to get a score in centipawns.
+//
+// File layout (little endian): the 16-byte FileHeader followed by
+//   int16 ft_weights[num_features][ft_size], int16 ft_biases[ft_size],
+//   int16 l1_weights[l1_size][2 * ft_size], int32 l1_biases[l1_size],
+//   int16 out_weights[l1_size], int32 out_bias
+namespace la::nnue
+{
+
+constexpr int num_piece_kinds = 5; // Pawn, knight, rook, queen, king.
+constexpr int num_squares = board_side * board_side;
+constexpr int num_features = 2 * num_piece_kinds * num_squares;
+constexpr int ft_size = 128;
+constexpr int l1_size = 32;
+
+constexpr int activation_max = 127;
+constexpr int l1_shift = 6;
+constexpr int output_scale = 16;
+
+struct FileHeader
+{
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t ft_size;
+  std::uint32_t l1_size;
+};
+
+constexpr char file_magic[4] = { 'L', 'A', 'N', 'N' };
+constexpr std::uint32_t file_version = 1;
+
+struct alignas(32) Accumulator
+{
+  std::array<std::array<std::int16_t, ft_size>, 2> values;
+  bool valid = false;
+};
+
+// Feature updates apply to both perspectives.
+void add_feature(Accumulator&, Colour, PieceType, int loc);
+void remove_feature(Accumulator&, Colour, PieceType, int loc);
+
+// Start an accumulator from the biases, ready for the board's features to be added.
+void reset(Accumulator&);
+
+// The score from the perspective of the player to move.
+int evaluate(const Accumulator&, Colour player_to_move);
+
+}
@@ -0,0 +1,105 @@
+#include "engine/packed_position.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+constexpr int num_piece_codes = 6;
+
+// Piece letters indexed by piece type, as in the FEN-style notation.
+constexpr const char* white_piece_chars = " PPNRQK";
+constexpr const char* black_piece_chars = " ppnrqk";
+
+}
+
+namespace la
+{
+
+PackedPosition PackedPosition::from_board(const Board& board)
+{
+  PackedPosition packed = {};
+  for (int row = 0; row < board_side; row++)
+  {
+    for (int col = 0; col < board_side; col++)
+    {
+      const auto piece = board.get_piece(row, col);
+      if (!piece) continue;
+
+      const int code = static_cast<int>(piece->type) +
+        (piece->colour == Colour::BLACK ? num_piece_codes : 0);
+
+      const int loc = row * board_side + col;
+      packed.squares[loc / 2] |= static_cast<std::uint8_t>(code << (4 * (loc % 2)));
+    }
+  }
+
+  packed.player_to_move = static_cast<std::uint8_t>(board.player_to_move());
+  packed.halfmove_clock = static_cast<std::uint8_t>(std::min(board.halfmove_clock(), 255));
+  return packed;
+}
+
+std::optional<Piece> PackedPosition::get_piece(int row, int col) const
+{
+  const int loc = row * board_side + col;
+  const int code = (squares[loc / 2] >> (4 * (loc % 2))) & 0xF;
+  if (code == 0)
+  {
+    return std::nullopt;
+  }
+
+  return code > num_piece_codes
+    ? Piece { Colour::BLACK, static_cast<PieceType>(code - num_piece_codes) }
+    : Piece { Colour::WHITE, static_cast<PieceType>(code) };
+}
+
+Board PackedPosition::to_board() const
+{
+  // Build the FEN-style notation, which the board validates.
+  std::string fen;
+  for (int row = board_side - 1; row >= 0; row--)
+  {
+    int num_empty = 0;
+    for (int col = 0; col < board_side; col++)
+    {
+      const auto piece = get_piece(row, col);
+      if (!piece)
+      {
+        ++num_empty;
+        continue;
+      }
+
+      if (num_empty > 0)
+      {
+        fen += std::to_string(num_empty);
+        num_empty = 0;
+      }
+
+      const int type = static_cast<int>(piece->type);
+      if (type > num_piece_codes)
+      {
+        throw std::invalid_argument("Invalid piece code in packed position");
+      }
+
+      fen += piece->colour == Colour::WHITE ? white_piece_chars[type] : black_piece_chars[type];
+    }
+
+    if (num_empty > 0)
+    {
+      fen += std::to_string(num_empty);
+    }
+
+    if (row > 0)
+    {
+      fen += '/';
+    }
+  }
+
+  fen += get_player_to_move() == Colour::WHITE ? " w" : " b";
+  fen += " " + std::to_string(halfmove_clock);
+  return Board(fen);
+}
+
+}
@@ -0,0 +1,114 @@
+#include "engine/shared_memory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace la
+{
+
+SharedMemory::SharedMemory(const std::string& name, std::size_t size)
+{
+  // Exactly one process creates the segment and sets its size; the others open it.
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  created_ = fd >= 0;
+  if (created_)
+  {
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+      close(fd);
+      shm_unlink(name.c_str());
+      throw std::runtime_error("Failed to size shared memory " + name);
+    }
+  }
+  else
+  {
+    fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0)
+    {
+      throw std::runtime_error("Failed to open shared memory " + name);
+    }
+
+    // The creator may not have sized the segment yet.
+    struct stat st;
+    bool stat_ok = fstat(fd, &st) == 0;
+    for (int attempt = 0; stat_ok && st.st_size == 0 && attempt < 1000; attempt++)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      stat_ok = fstat(fd, &st) == 0;
+    }
+
+    if (!stat_ok)
+    {
+      close(fd);
+      throw std::runtime_error("Failed to open shared memory " + name);
+    }
+
+    if (static_cast<std::size_t>(st.st_size) != size)
+    {
+      close(fd);
+      throw std::runtime_error("Shared memory " + name + " has a different size");
+    }
+  }
+
+  void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+
+  if (addr == MAP_FAILED)
+  {
+    throw std::runtime_error("Failed to map shared memory " + name);
+  }
+
+  data_ = static_cast<std::uint8_t*>(addr);
+  size_ = size;
+}
+
+SharedMemory::SharedMemory(SharedMemory&& other)
+  : data_(std::exchange(other.data_, nullptr)),
+    size_(std::exchange(other.size_, 0)),
+    created_(std::exchange(other.created_, false))
+{
+}
+
+SharedMemory& SharedMemory::operator=(SharedMemory&& other)
+{
+  if (this != &other)
+  {
+    unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    created_ = std::exchange(other.created_, false);
+  }
+
+  return *this;
+}
+
+SharedMemory::~SharedMemory()
+{
+  unmap();
+}
+
+void SharedMemory::remove(const std::string& name)
+{
+  shm_unlink(name.c_str());
+}
+
+void SharedMemory::unmap()
+{
+  if (data_ != nullptr)
+  {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+}
@@ -0,0 +1,166 @@
+#include "engine/tablebase.h"
+#include "engine/mapped_file.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+
+struct Table
+{
+  la::MappedFile file;
+  std::vector<la::Piece> pieces;
+  const la::tablebase::Value* values;
+};
+
+std::unordered_map<la::material::Key, Table> tables;
+int max_pieces = 0;
+
+int num_pieces(la::material::Key key)
+{
+  // Count the 4-bit fields and add the two kings.
+  int count = 2;
+  for (; key != 0; key >>= 4)
+  {
+    count += key & 0xF;
+  }
+
+  return count;
+}
+
+}
+
+namespace la::tablebase
+{
+
+std::vector<Piece> pieces(material::Key key)
+{
+  std::vector<Piece> pieces;
+  for (const auto col : { Colour::WHITE, Colour::BLACK })
+  {
+    const auto pawn = col == Colour::WHITE ? PieceType::PAWN_WHITE : PieceType::PAWN_BLACK;
+
+    pieces.push_back({ col, PieceType::KING });
+    for (const auto pt : { PieceType::QUEEN, PieceType::ROOK, PieceType::KNIGHT, pawn })
+    {
+      const int count = (key / material::piece_key(col, pt)) & 0xF;
+      for (int i = 0; i < count; i++)
+      {
+        pieces.push_back({ col, pt });
+      }
+    }
+  }
+
+  return pieces;
+}
+
+std::size_t table_size(const std::vector<Piece>& pieces)
+{
+  std::size_t size = 2;
+  for (std::size_t i = 0; i < pieces.size(); i++)
+  {
+    size *= board_side * board_side;
+  }
+
+  return size;
+}
+
+std::size_t index(const Board& board, const std::vector<Piece>& pieces)
+{
+  // Pieces of the same type are assigned squares in the order they're found.
+  std::array<int, board_side * board_side> squares;
+  squares.fill(-1);
+
+  for (int loc = 0; loc < board_side * board_side; loc++)
+  {
+    const auto piece = board.get_piece(loc / board_side, loc % board_side);
+    if (!piece) continue;
+
+    for (std::size_t i = 0; i < pieces.size(); i++)
+    {
+      if (squares[i] < 0 && pieces[i].colour == piece->colour && pieces[i].type == piece->type)
+      {
+        squares[i] = loc;
+        break;
+      }
+    }
+  }
+
+  std::size_t idx = static_cast<std::size_t>(board.player_to_move());
+  std::size_t multiplier = 2;
+  for (std::size_t i = 0; i < pieces.size(); i++)
+  {
+    idx += squares[i] * multiplier;
+    multiplier *= board_side * board_side;
+  }
+
+  return idx;
+}
+
+int init(const std::string& directory)
+{
+  std::unordered_map<material::Key, Table> loaded;
+  int loaded_max_pieces = 0;
+  for (const auto& file : std::filesystem::directory_iterator(directory))
+  {
+    if (file.path().extension() != file_extension) continue;
+
+    const std::string path = file.path().string();
+    MappedFile mapped(path);
+
+    FileHeader header;
+    if (mapped.size() < sizeof(header))
+    {
+      throw std::runtime_error("Invalid tablebase file " + path);
+    }
+
+    std::memcpy(&header, mapped.data(), sizeof(header));
+
+    auto table_pieces = pieces(header.material_key);
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+        header.version != file_version ||
+        header.num_entries != table_size(table_pieces) ||
+        mapped.size() != sizeof(header) + header.num_entries)
+    {
+      throw std::runtime_error("Invalid tablebase file " + path);
+    }
+
+    const auto* values = mapped.data() + sizeof(header);
+    loaded[header.material_key] = { std::move(mapped), std::move(table_pieces), values };
+    loaded_max_pieces = std::max(loaded_max_pieces, num_pieces(header.material_key));
+  }
+
+  tables = std::move(loaded);
+  max_pieces = loaded_max_pieces;
+  return static_cast<int>(tables.size());
+}
+
+std::optional<int> probe(const Board& board)
+{
+  const auto key = board.material_key();
+  if (num_pieces(key) > max_pieces)
+  {
+    return std::nullopt;
+  }
+
+  const auto it = tables.find(key);
+  if (it == tables.end())
+  {
+    return std::nullopt;
+  }
+
+  const Table& table = it->second;
+  const Value value = table.values[index(board, table.pieces)];
+
+  if (is_win(value)) return eval::mate_score - plies_to_mate(value);
+  if (is_loss(value)) return -eval::mate_score + plies_to_mate(value);
+  if (value == draw) return 0;
+  return std::nullopt;
+}
+
+}
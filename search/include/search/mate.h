@@ -0,0 +1,45 @@
+#pragma once
+
+#include "engine/board.h"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+
+namespace la
+{
+
+struct MateResult
+{
+  Move move;
+  int plies; // Including the mating move.
+};
+
+class MateSolverImpl;
+
+// Looks for forced mates with depth-first proof-number search. A solver keeps its table of proof
+// numbers, which is about 24MB, for its lifetime, so later calls can reuse earlier work.
+class MateSolver
+{
+public:
+  MateSolver();
+  ~MateSolver();
+
+  // Look for a forced mate for the player to move within `max_plies`. The shortest mate found is
+  // returned. Gives up if `stop` is set.
+  std::optional<MateResult> find(
+    la::Board&,
+    int max_plies,
+    const std::atomic<bool>* stop = nullptr);
+
+private:
+  std::unique_ptr<MateSolverImpl> impl_;
+};
+
+// As MateSolver::find with a solver kept by the calling thread.
+std::optional<MateResult> find_mate(
+  la::Board&,
+  int max_plies,
+  const std::atomic<bool>* stop = nullptr);
+
+}
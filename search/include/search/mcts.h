@@ -0,0 +1,44 @@
+#pragma once
+
+#include "search/search.h"
+
+#include <cstddef>
+#include <functional>
+
+// Monte Carlo tree search: an alternative to the alpha-beta search with the same interface.
+namespace la::mcts
+{
+
+struct Params
+{
+  // Worker threads sharing the tree. Zero uses one per hardware thread.
+  unsigned threads = 0;
+
+  // The tree's node capacity. Once it's full, leaves are evaluated without being expanded.
+  // Nodes take 40 bytes, and each calling thread keeps the largest tree it has used. Searches
+  // limited by nodes use a smaller tree when that's enough for their playouts.
+  std::size_t max_nodes = 1 << 22;
+
+  // PUCT exploration constant.
+  float exploration = 1.5f;
+
+  // The number of losses temporarily added to a node while a thread is searching below it, to
+  // steer other threads elsewhere.
+  int virtual_loss = 3;
+
+  // Leaves are evaluated by a quiescence search of this depth.
+  int quiescence_depth = 5;
+
+  // Centipawn scores are mapped to values in [-1, 1] by tanh(score / score_scale).
+  float score_scale = 400.0f;
+};
+
+// Blocking search. The limit on nodes applies to playouts. The SearchData's depth is the deepest
+// line in the tree, and its node count is the number of playouts.
+Move search(
+  la::Board&,
+  const SearchLimits&,
+  std::function<void(const SearchData&)>,
+  const Params& params = {});
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "search/search.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace la
+{
+
+struct SearchResult
+{
+  Move best_move; // Zero if the position has no legal moves or the search failed.
+  SearchData data; // The last data the search reported.
+
+  // Set if the search threw, e.g. std::runtime_error when a shared table can't be mapped. Futures
+  // rethrow the exception instead.
+  std::exception_ptr error;
+};
+
+// A fixed set of threads which search positions from a shared queue.
+// The threads live as long as the pool, so each keeps its transposition table warm from one
+// search to the next. Each table is allocated by its thread's first search and is
+// `params.hash_size_mb`, so once every thread has searched the pool holds that many megabytes per
+// thread, e.g. 1.5GB for 32 threads with the default hash size. Short searches don't need large
+// tables, so lower the hash size when searching many positions.
+// A thread whose search starts the mate solver also keeps a parked solver thread with a table of
+// about 24MB, and one with `params.threads` above one keeps that many helper threads. Set
+// `params.mate_solver_max_plies` to zero to avoid the solver's cost.
+class SearchPool
+{
+public:
+  explicit SearchPool(unsigned num_threads = std::thread::hardware_concurrency());
+  ~SearchPool();
+
+  SearchPool(const SearchPool&) = delete;
+  SearchPool& operator=(const SearchPool&) = delete;
+
+  std::size_t size() const { return threads_.size(); }
+
+  std::future<SearchResult> submit(
+    const Board&,
+    const SearchLimits&,
+    const SearchParams& params = {});
+
+  // The callback runs on the pool thread which did the search.
+  void submit(
+    const Board&,
+    const SearchLimits&,
+    std::function<void(const SearchResult&)> on_complete,
+    const SearchParams& params = {});
+
+  std::vector<std::future<SearchResult>> search_many(
+    const std::vector<Board>&,
+    const SearchLimits&,
+    const SearchParams& params = {});
+
+  // The callback is given the index of each position as its search completes.
+  void search_many(
+    const std::vector<Board>&,
+    const SearchLimits&,
+    std::function<void(std::size_t, const SearchResult&)> on_complete,
+    const SearchParams& params = {});
+
+  // Blocks until every submitted search has completed. Rethrows the first exception thrown by a
+  // completion callback since the last wait.
+  void wait();
+
+private:
+  std::mutex mutex_;
+  std::condition_variable work_cv_, idle_cv_;
+  std::deque<std::function<void()>> jobs_;
+  std::size_t num_busy_ = 0;
+  std::exception_ptr error_;
+  bool quit_ = false;
+  std::vector<std::thread> threads_;
+
+  void enqueue(std::function<void()>);
+  void thread_func();
+};
+
+// Search every position using a pool shared by the whole process, with a thread per core. The pool
+// is created by the first call and its threads keep their tables until the process exits.
+std::vector<SearchResult> search_many(
+  const std::vector<Board>&,
+  const SearchLimits&,
+  const SearchParams& params = {});
+
+}
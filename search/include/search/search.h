@@ -4,39 +4,161 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <string>
 #include <thread>
 
 namespace la
 {
 
+// Scores within this of eval::mate_score are forced mates, and the difference is the number of
+// plies to mate.
+constexpr int mate_window = 1000;
+
 struct SearchData
 {
   int depth;
   int score;
   la::Move best_move;
-  std::uint64_t nodes_searched;
+  std::uint64_t nodes_searched; // In this iteration, by the calling thread.
   std::chrono::milliseconds time_taken;
+
+  // Statistics for the whole search so far. The counts include any helper threads'.
+  std::uint64_t total_nodes = 0;
+  std::uint64_t quiescence_nodes = 0;
+  std::uint64_t nodes_per_second = 0;
+  int seldepth = 0; // The deepest ply reached, including quiescence.
+  double tt_hit_rate = 0.0;
+  double pawn_hit_rate = 0.0; // Of the pawn structure table.
+  int hashfull = 0; // Transposition table entries in use per thousand.
+  double first_move_cutoff_rate = 0.0; // The proportion of cut-offs caused by the first move.
+  double branching_factor = 0.0; // This iteration's nodes over the previous iteration's.
+};
+
+// Parameters controlling the search's resources and selectivity.
+// Depths are in plies and margins are in centipawns.
+struct SearchParams
+{
+  // Each thread which calls search keeps a transposition table of this size between searches.
+  std::size_t hash_size_mb = 48;
+
+  // If set, the table is a POSIX shared memory segment of this name, e.g. "/la_hash", which all
+  // processes searching with the same name and hash size share. The segment persists until it's
+  // removed with la::SharedMemory::remove.
+  std::string shared_hash_name;
+
+  // Lazy SMP: this many threads search the position together, sharing the table.
+  int threads = 1;
+
+  // Internal iterative deepening: search nodes without a hash move at reduced depth first.
+  int iid_min_depth = 5;
+  int iid_reduction = 2;
+
+  // Singular extensions: extend a hash move which beats the alternatives by
+  // `singular_margin_per_ply * depth`.
+  int singular_min_depth = 6;
+  int singular_margin_per_ply = 20;
+
+  // Null move pruning reduces by `null_move_reduction + depth / null_move_depth_divisor`. From
+  // `null_move_verification_depth` onwards a cut-off must be confirmed by a search without null moves.
+  int null_move_min_depth = 4;
+  int null_move_reduction = 3;
+  int null_move_depth_divisor = 6;
+  int null_move_verification_depth = 8;
+
+  // Reverse futility pruning: return beta when the static score beats it by
+  // `reverse_futility_margin * (depth - 1)`.
+  int reverse_futility_max_depth = 3;
+  int reverse_futility_margin = 100;
+
+  // Futility pruning: skip quiet moves when the static score is `futility_margin * depth` below alpha.
+  int futility_max_depth = 2;
+  int futility_margin = 150;
+
+  // Late move pruning: skip quiet moves after `late_move_base + depth * depth` moves have been tried.
+  int late_move_max_depth = 3;
+  int late_move_base = 4;
+
+  // ProbCut: a capture which beats `beta + probcut_margin` at `depth - probcut_reduction` is
+  // assumed to beat beta at full depth.
+  int probcut_min_depth = 5;
+  int probcut_reduction = 4;
+  int probcut_margin = 200;
+
+  // Mate solver: once the score reaches `mate_solver_min_score` a proof-number search for mates of
+  // up to `mate_solver_max_plies` runs alongside the main search. Zero plies disables it.
+  int mate_solver_min_score = 300;
+  int mate_solver_max_plies = 15;
+};
+
+// Limits on how long a search may run. Zero means unlimited.
+// A search limited only by depth is deterministic if the mate solver is disabled.
+struct SearchLimits
+{
+  std::chrono::milliseconds time{0};
+
+  // If set the search won't start an iteration it expects to finish after this time, which is
+  // extended while the best move is unstable. `time` remains a hard limit. See allocate_time for
+  // limits suited to a clock.
+  std::chrono::milliseconds soft_time{0};
+
+  std::uint64_t nodes = 0;
+  int depth = 0;
+
+  // The search stops as soon as possible once this is set.
+  const std::atomic<bool>* stop = nullptr;
 };
 
 // Blocking search.
-Move search(la::Board&, std::chrono::milliseconds, std::function<void(const SearchData&)>);
+// Searches on different threads are independent, so several can run concurrently.
+Move search(
+  la::Board&,
+  std::chrono::milliseconds,
+  std::function<void(const SearchData&)>,
+  const SearchParams& params = {});
 
+Move search(
+  la::Board&,
+  const SearchLimits&,
+  std::function<void(const SearchData&)>,
+  const SearchParams& params = {});
+
+// Save the calling thread's transposition table, which its searches have filled, so that a later
+// process can start from it with load_table. With a minimum depth only entries searched at least
+// that deep are saved, in a compact form. Otherwise the whole table is saved as an image, which
+// loads quickly by being mapped. The next search treats the loaded entries as its own, whatever
+// the thread searched before. Both throw std::runtime_error on failure.
+void save_table(const std::string& path, int min_depth = 0);
+void load_table(const std::string& path);
+
+// Searches in the background on a thread which waits between searches, so starting a search
+// doesn't start a thread and the thread's transposition table stays warm.
 class SearchWorker
 {
 public:
   SearchWorker(std::function<void(const SearchData&)>);
   ~SearchWorker();
 
+  // Waits for any search which is still running before starting the next.
   void start(const la::Board&, std::chrono::milliseconds);
+  void start(const la::Board&, const SearchLimits&);
   bool running() const { return running_.load(); }
 
 private:
   std::function<void(const SearchData&)> callback_;
   std::atomic<bool> running_;
-  std::thread worker_;
   Board board_;
-  std::chrono::milliseconds timeout_;
+  SearchLimits limits_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool has_work_ = false;
+  bool quit_ = false;
+
+  // Declared last so everything it uses is constructed before it starts.
+  std::thread worker_;
 
   void search_worker_func();
 };
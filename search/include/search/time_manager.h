@@ -0,0 +1,56 @@
+#pragma once
+
+#include "engine/board.h"
+
+#include <chrono>
+
+namespace la
+{
+
+// A player's clock at the start of a move.
+struct TimeControl
+{
+  std::chrono::milliseconds remaining{0};
+  std::chrono::milliseconds increment{0};
+  int moves_to_go = 0; // Zero if the rest of the game must be played in the remaining time.
+};
+
+// The search aims to finish within the soft limit and must stop at the hard one.
+struct TimeAllocation
+{
+  std::chrono::milliseconds soft;
+  std::chrono::milliseconds hard;
+};
+
+TimeAllocation allocate_time(const TimeControl&);
+
+// Decides between iterations whether another is worth starting.
+class TimeManager
+{
+public:
+  TimeManager(std::chrono::milliseconds soft, std::chrono::milliseconds hard);
+
+  // Record an iteration which has just completed. Times are since the start of the search.
+  void iteration_complete(
+    std::chrono::steady_clock::duration elapsed,
+    std::uint64_t iteration_nodes,
+    Move best_move,
+    int score);
+
+  // The next iteration is skipped if it isn't expected to finish within the soft limit. The limit
+  // is extended while the best move keeps changing or the score is falling.
+  bool start_next_iteration(std::chrono::steady_clock::duration elapsed) const;
+
+private:
+  std::chrono::steady_clock::duration soft_, hard_;
+  std::chrono::steady_clock::duration last_elapsed_{0}, last_iteration_time_{0};
+  std::uint64_t last_iteration_nodes_ = 0;
+  double branching_factor_ = 0.0;
+  double instability_ = 0.0;
+  double score_drop_ = 0.0;
+  Move best_move_ = 0;
+  int score_ = 0;
+  int num_iterations_ = 0;
+};
+
+}
@@ -0,0 +1,245 @@
+#include "search/mate.h"
+#include "engine/tt.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+// Proof and disproof numbers are from the attacker's perspective: the proof number is the
+// minimum number of leaves which must be proven to show a mate, and the disproof number the
+// minimum number which must be disproven to show that there isn't one.
+constexpr std::uint32_t infinity = std::numeric_limits<std::uint32_t>::max() / 2;
+
+// Distinguishes positions where the defender is to move from the same position searched with
+// the other player attacking.
+constexpr std::uint64_t defender_key = 0x9E3779B97F4A7C15ULL;
+
+struct Entry
+{
+  std::uint64_t hash;
+  std::uint32_t proof;
+  std::uint32_t disproof;
+  int depth; // The number of plies the attacker had left.
+};
+
+// The table is bounded: later nodes overwrite earlier ones which share a slot.
+using Table = la::TT<Entry>;
+
+struct Numbers
+{
+  std::uint32_t proof;
+  std::uint32_t disproof;
+};
+
+std::uint32_t add(std::uint32_t a, std::uint32_t b)
+{
+  return std::min(a + b, infinity);
+}
+
+class Solver
+{
+public:
+  Solver(Table& table, const std::atomic<bool>* stop)
+    : table_(table), stop_(stop)
+  {
+  }
+
+  // Search the node until it's resolved or it exceeds a threshold.
+  Numbers mid(la::Board&, bool attacker, int depth, Numbers thresholds);
+  Numbers lookup(std::uint64_t hash, bool attacker, int depth) const;
+  bool stopped() const { return stop_ && stop_->load(std::memory_order_relaxed); }
+
+private:
+  Table& table_;
+  const std::atomic<bool>* stop_;
+
+  void store(std::uint64_t hash, bool attacker, int depth, Numbers);
+
+  static std::uint64_t key(std::uint64_t hash, bool attacker)
+  {
+    return attacker ? hash : hash ^ defender_key;
+  }
+};
+
+Numbers Solver::lookup(std::uint64_t hash, bool attacker, int depth) const
+{
+  Entry* entry;
+  if (table_.probe(key(hash, attacker), &entry))
+  {
+    // A mate found with fewer plies is still a mate with more, and a position which survives
+    // more plies also survives fewer.
+    if ((entry->proof == 0 && entry->depth <= depth) ||
+        (entry->disproof == 0 && entry->depth >= depth) ||
+        entry->depth == depth)
+    {
+      return { entry->proof, entry->disproof };
+    }
+  }
+
+  return { 1, 1 };
+}
+
+void Solver::store(std::uint64_t hash, bool attacker, int depth, Numbers numbers)
+{
+  Entry* entry;
+  table_.probe(key(hash, attacker), &entry);
+  *entry = { key(hash, attacker), numbers.proof, numbers.disproof, depth };
+}
+
+Numbers Solver::mid(la::Board& board, bool attacker, int depth, Numbers thresholds)
+{
+  const auto hash = board.hash();
+  const auto moves = board.get_moves();
+  if (moves.empty())
+  {
+    // Only checkmating the defender counts: stalemate and repetition are draws.
+    const bool mated = !attacker && !board.is_draw() && board.in_check();
+    const auto numbers = mated ? Numbers { 0, infinity } : Numbers { infinity, 0 };
+    store(hash, attacker, depth, numbers);
+    return numbers;
+  }
+
+  if (depth == 0)
+  {
+    store(hash, attacker, depth, { infinity, 0 });
+    return { infinity, 0 };
+  }
+
+  // Keep the children's numbers locally so that the search can't lose track of them when the
+  // table overwrites their entries.
+  std::vector<Numbers> children;
+  children.reserve(moves.size());
+  for (const auto move : moves)
+  {
+    board.make_move(move);
+    children.push_back(lookup(board.hash(), !attacker, depth - 1));
+    board.undo_move(move);
+  }
+
+  // At the attacker's nodes a single proven child proves the node and every child must be
+  // disproven, and vice versa at the defender's nodes. Work with the numbers from the point of
+  // view of the player to move: `phi` for their goal and `delta` for the opponent's.
+  const auto phi = [attacker] (Numbers n) { return attacker ? n.proof : n.disproof; };
+  const auto delta = [attacker] (Numbers n) { return attacker ? n.disproof : n.proof; };
+  const auto make_numbers = [attacker] (std::uint32_t phi, std::uint32_t delta)
+  {
+    return attacker ? Numbers { phi, delta } : Numbers { delta, phi };
+  };
+
+  Numbers numbers;
+  while (true)
+  {
+    std::uint32_t min_phi = infinity, second_phi = infinity, sum_delta = 0;
+    std::size_t best = 0;
+    Numbers best_child = { infinity, infinity };
+    for (std::size_t i = 0; i < moves.size(); i++)
+    {
+      const auto child = children[i];
+      sum_delta = add(sum_delta, delta(child));
+
+      if (phi(child) < min_phi)
+      {
+        second_phi = min_phi;
+        min_phi = phi(child);
+        best = i;
+        best_child = child;
+      }
+      else if (phi(child) < second_phi)
+      {
+        second_phi = phi(child);
+      }
+    }
+
+    numbers = make_numbers(min_phi, sum_delta);
+    if (min_phi >= phi(thresholds) || sum_delta >= delta(thresholds) || stopped())
+    {
+      break;
+    }
+
+    // Search the most promising child until it either resolves or becomes worse than the
+    // second best.
+    const std::uint32_t child_phi = std::min(phi(thresholds), add(second_phi, 1));
+    const std::uint32_t child_delta = delta(thresholds) - sum_delta + delta(best_child);
+
+    board.make_move(moves[best]);
+    children[best] = mid(board, !attacker, depth - 1, make_numbers(child_phi, child_delta));
+    board.undo_move(moves[best]);
+  }
+
+  store(hash, attacker, depth, numbers);
+  return numbers;
+}
+
+}
+
+namespace la
+{
+
+class MateSolverImpl
+{
+public:
+  Table table{1 << 20};
+};
+
+MateSolver::MateSolver() : impl_(std::make_unique<MateSolverImpl>())
+{
+}
+
+MateSolver::~MateSolver() = default;
+
+std::optional<MateResult> MateSolver::find(
+  la::Board& board,
+  int max_plies,
+  const std::atomic<bool>* stop)
+{
+  Solver solver(impl_->table, stop);
+
+  // Mates end on the attacker's move, so only odd numbers of plies need searching. Deepening
+  // finds the shortest mate first.
+  for (int plies = 1; plies <= max_plies; plies += 2)
+  {
+    if (solver.mid(board, true, plies, { infinity, infinity }).proof != 0)
+    {
+      if (solver.stopped())
+      {
+        return std::nullopt;
+      }
+
+      continue;
+    }
+
+    // Any proven child of the root mates in time. Their entries will almost always still be in
+    // the table, but otherwise solve the children again.
+    const auto moves = board.get_moves();
+    for (const bool resolve : { false, true })
+    {
+      for (const auto move : moves)
+      {
+        board.make_move(move);
+        const auto child = resolve
+          ? solver.mid(board, false, plies - 1, { infinity, infinity })
+          : solver.lookup(board.hash(), false, plies - 1);
+        board.undo_move(move);
+
+        if (child.proof == 0)
+        {
+          return MateResult { move, plies };
+        }
+      }
+    }
+  }
+
+  return std::nullopt;
+}
+
+std::optional<MateResult> find_mate(la::Board& board, int max_plies, const std::atomic<bool>* stop)
+{
+  thread_local MateSolver solver;
+  return solver.find(board, max_plies, stop);
+}
+
+}
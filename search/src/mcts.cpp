@@ -0,0 +1,398 @@
+#include "search/mcts.h"
+#include "quiescence.h"
+#include "engine/instrument.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Values are accumulated in fixed point so that they can be summed atomically.
+constexpr std::int64_t value_scale = 1 << 16;
+
+// Material values for weighting the priors of captures and promotions.
+constexpr std::array<int, 7> piece_values = { 0, 100, 100, 300, 500, 900, 0 };
+
+int piece_value(la::PieceType pt)
+{
+  return piece_values[static_cast<int>(pt)];
+}
+
+enum class NodeState : std::uint8_t
+{
+  LEAF,
+  EXPANDING,
+  EXPANDED
+};
+
+// A node's value is from the perspective of the player who made its move.
+struct Node
+{
+  la::Move move = 0;
+  float prior = 0.0f;
+  std::uint32_t first_child = 0;
+  std::uint32_t num_children = 0;
+  std::atomic<NodeState> state{NodeState::LEAF};
+  std::atomic<std::int32_t> visits{0};
+  std::atomic<std::int32_t> virtual_losses{0};
+  std::atomic<std::int64_t> value_sum{0};
+
+  void reset()
+  {
+    move = 0;
+    prior = 0.0f;
+    first_child = 0;
+    num_children = 0;
+    state.store(NodeState::LEAF, std::memory_order_relaxed);
+    visits.store(0, std::memory_order_relaxed);
+    virtual_losses.store(0, std::memory_order_relaxed);
+    value_sum.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Node-limited searches size their tree for this many nodes per playout, since each playout
+// expands at most one node's children.
+constexpr std::size_t nodes_per_playout = 64;
+
+// The nodes are allocated from a fixed arena, with each node's children stored contiguously.
+class Tree
+{
+public:
+  // Prepare for a search using up to `capacity` nodes. The arena only grows, so later searches
+  // reuse it and only the nodes used by the last search need clearing.
+  void reset(std::size_t capacity)
+  {
+    capacity = std::max<std::size_t>(capacity, 1);
+    if (nodes_.size() < capacity)
+    {
+      nodes_ = std::vector<Node>(capacity);
+    }
+    else
+    {
+      const auto used = std::min<std::size_t>(size_.load(), nodes_.size());
+      for (std::size_t i = 0; i < used; i++)
+      {
+        nodes_[i].reset();
+      }
+    }
+
+    capacity_ = capacity;
+    size_.store(1);
+  }
+
+  Node& root() { return nodes_[0]; }
+  Node& operator[](std::uint32_t i) { return nodes_[i]; }
+
+  // Returns the index of the first node, or zero if the arena is full.
+  std::uint32_t allocate(std::uint32_t count)
+  {
+    const auto first = size_.fetch_add(count);
+    return first + count <= capacity_ ? first : 0;
+  }
+
+private:
+  std::vector<Node> nodes_;
+  std::size_t capacity_ = 0;
+  std::atomic<std::uint32_t> size_{1};
+};
+
+class Searcher
+{
+public:
+  Searcher(const la::mcts::Params& params, const la::SearchLimits& limits, Tree& tree)
+    : params_(params), tree_(tree), limits_(limits)
+  {
+  }
+
+  void set_end_time(Clock::time_point end_time) { end_time_ = end_time; }
+  bool in_limits() const;
+  void playout(la::Board&, std::vector<std::uint32_t>& path);
+  void run(la::Board);
+  la::SearchData data(Clock::time_point start_time);
+
+private:
+  const la::mcts::Params& params_;
+  Tree& tree_;
+  la::SearchLimits limits_;
+  Clock::time_point end_time_;
+  std::atomic<std::uint64_t> num_playouts_{0};
+  std::atomic<int> max_depth_{0};
+
+  std::uint32_t select_child(Node&);
+  double expand(Node&, la::Board&);
+  double evaluate(la::Board&) const;
+
+  double to_value(int score) const
+  {
+    return std::tanh(score / params_.score_scale);
+  }
+
+  int to_score(double value) const
+  {
+    return static_cast<int>(params_.score_scale * std::atanh(std::clamp(value, -0.999, 0.999)));
+  }
+};
+
+bool Searcher::in_limits() const
+{
+  return Clock::now() < end_time_ &&
+    (limits_.nodes == 0 || num_playouts_.load(std::memory_order_relaxed) < limits_.nodes);
+}
+
+void Searcher::run(la::Board board)
+{
+  std::vector<std::uint32_t> path;
+  while (in_limits())
+  {
+    playout(board, path);
+  }
+
+  LA_AGGREGATE();
+}
+
+// Choose the child maximising Q + U, where U favours children with high priors and few visits.
+std::uint32_t Searcher::select_child(Node& node)
+{
+  const int parent_visits =
+    node.visits.load(std::memory_order_relaxed) + node.virtual_losses.load(std::memory_order_relaxed);
+  const double exploration = params_.exploration * std::sqrt(static_cast<double>(parent_visits + 1));
+
+  std::uint32_t best = node.first_child;
+  double best_score = -1e9;
+  for (std::uint32_t i = node.first_child; i < node.first_child + node.num_children; i++)
+  {
+    const Node& child = tree_[i];
+    const int visits = child.visits.load(std::memory_order_relaxed);
+    const int losses = child.virtual_losses.load(std::memory_order_relaxed);
+
+    // Each virtual loss counts as a visit which lost.
+    const double q = visits + losses > 0
+      ? (child.value_sum.load(std::memory_order_relaxed) - losses * value_scale) /
+          static_cast<double>(value_scale * (visits + losses))
+      : 0.0;
+
+    const double score = q + exploration * child.prior / (1 + visits + losses);
+    if (score > best_score)
+    {
+      best_score = score;
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+// The value of the position for the player to move.
+double Searcher::evaluate(la::Board& board) const
+{
+  return to_value(la::detail::quiescence_score(board, params_.quiescence_depth));
+}
+
+// Add the node's children and return its value for the player to move.
+double Searcher::expand(Node& node, la::Board& board)
+{
+  const auto moves = board.get_moves();
+  if (moves.empty())
+  {
+    const bool mated = !board.is_draw() && board.in_check();
+    node.state.store(NodeState::LEAF, std::memory_order_release);
+    return mated ? -1.0 : 0.0;
+  }
+
+  const auto first = tree_.allocate(static_cast<std::uint32_t>(moves.size()));
+  if (first == 0)
+  {
+    // The tree is full.
+    node.state.store(NodeState::LEAF, std::memory_order_release);
+    return evaluate(board);
+  }
+
+  // Priors favour captures and promotions of valuable material.
+  std::vector<double> weights(moves.size());
+  double total = 0.0;
+  for (std::size_t i = 0; i < moves.size(); i++)
+  {
+    const auto gain =
+      piece_value(la::move::get_cap(moves[i])) + piece_value(la::move::get_promo(moves[i]));
+
+    weights[i] = std::exp(gain / params_.score_scale);
+    total += weights[i];
+  }
+
+  for (std::size_t i = 0; i < moves.size(); i++)
+  {
+    auto& child = tree_[first + static_cast<std::uint32_t>(i)];
+    child.move = moves[i];
+    child.prior = static_cast<float>(weights[i] / total);
+  }
+
+  node.first_child = first;
+  node.num_children = static_cast<std::uint32_t>(moves.size());
+  node.state.store(NodeState::EXPANDED, std::memory_order_release);
+
+  return evaluate(board);
+}
+
+void Searcher::playout(la::Board& board, std::vector<std::uint32_t>& path)
+{
+  path.clear();
+  path.push_back(0);
+
+  // Descend to a leaf, adding virtual losses along the way.
+  std::uint32_t index = 0;
+  while (tree_[index].state.load(std::memory_order_acquire) == NodeState::EXPANDED)
+  {
+    index = select_child(tree_[index]);
+    tree_[index].virtual_losses.fetch_add(params_.virtual_loss, std::memory_order_relaxed);
+    board.make_move(tree_[index].move);
+    path.push_back(index);
+  }
+
+  // Only one thread expands a leaf. Others which arrive meanwhile just evaluate it.
+  auto& leaf = tree_[index];
+  auto expected = NodeState::LEAF;
+  const bool expanding = leaf.visits.load(std::memory_order_relaxed) == 0 &&
+    leaf.state.compare_exchange_strong(expected, NodeState::EXPANDING, std::memory_order_acq_rel);
+
+  double value;
+  if (expanding)
+  {
+    value = expand(leaf, board);
+  }
+  else
+  {
+    const auto moves = board.get_moves();
+    value = moves.empty()
+      ? (!board.is_draw() && board.in_check() ? -1.0 : 0.0)
+      : evaluate(board);
+  }
+
+  int depth = static_cast<int>(path.size()) - 1;
+  int max_depth = max_depth_.load(std::memory_order_relaxed);
+  while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth));
+
+  // Back the value up the path. The value is for the player to move at the leaf, so it's a loss
+  // for the player who moved into it.
+  for (auto it = path.rbegin(); it != path.rend(); ++it)
+  {
+    value = -value;
+
+    auto& node = tree_[*it];
+    node.value_sum.fetch_add(static_cast<std::int64_t>(value * value_scale), std::memory_order_relaxed);
+    node.visits.fetch_add(1, std::memory_order_relaxed);
+    if (*it != 0)
+    {
+      node.virtual_losses.fetch_sub(params_.virtual_loss, std::memory_order_relaxed);
+      board.undo_move(node.move);
+    }
+  }
+
+  num_playouts_.fetch_add(1, std::memory_order_relaxed);
+}
+
+la::SearchData Searcher::data(Clock::time_point start_time)
+{
+  // The most visited move is the most reliable.
+  auto& root = tree_.root();
+  const bool expanded = root.state.load(std::memory_order_acquire) == NodeState::EXPANDED;
+  const std::uint32_t num_children = expanded ? root.num_children : 0;
+  const Node* best = nullptr;
+  for (std::uint32_t i = root.first_child; i < root.first_child + num_children; i++)
+  {
+    if (!best || tree_[i].visits.load() > best->visits.load())
+    {
+      best = &tree_[i];
+    }
+  }
+
+  la::SearchData data = {};
+  data.depth = max_depth_.load();
+  data.nodes_searched = num_playouts_.load();
+  data.time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time);
+  data.total_nodes = data.nodes_searched;
+  data.nodes_per_second = data.total_nodes * 1000 / std::max<std::int64_t>(1, data.time_taken.count());
+  if (best)
+  {
+    const int visits = best->visits.load();
+    data.best_move = best->move;
+    data.score = visits > 0
+      ? to_score(best->value_sum.load() / static_cast<double>(value_scale * visits))
+      : 0;
+  }
+
+  return data;
+}
+
+}
+
+namespace la::mcts
+{
+
+Move search(
+  la::Board& board,
+  const SearchLimits& limits,
+  std::function<void(const SearchData&)> callback,
+  const Params& params)
+{
+  const auto moves = board.get_moves();
+
+  assert(!moves.empty());
+
+  const auto start_time = Clock::now();
+
+  // Each thread keeps its tree's arena between searches.
+  thread_local Tree tree;
+  tree.reset(limits.nodes > 0
+    ? std::min<std::size_t>(params.max_nodes, limits.nodes * nodes_per_playout)
+    : params.max_nodes);
+
+  Searcher searcher(params, limits, tree);
+  searcher.set_end_time(limits.time.count() > 0 ? start_time + limits.time : Clock::time_point::max());
+
+  const unsigned num_threads = params.threads > 0
+    ? params.threads
+    : std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < num_threads; t++)
+  {
+    workers.emplace_back(&Searcher::run, &searcher, board);
+  }
+
+  // This thread searches too, and reports progress at intervals.
+  constexpr std::chrono::milliseconds report_interval{100};
+  auto next_report = start_time + report_interval;
+  std::vector<std::uint32_t> path;
+  while (searcher.in_limits())
+  {
+    searcher.playout(board, path);
+    if (Clock::now() >= next_report)
+    {
+      callback(searcher.data(start_time));
+      next_report += report_interval;
+    }
+  }
+
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  LA_AGGREGATE();
+
+  const auto data = searcher.data(start_time);
+  callback(data);
+
+  return data.best_move != 0 ? data.best_move : moves[0];
+}
+
+}
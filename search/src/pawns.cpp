@@ -0,0 +1,96 @@
+#include "pawns.h"
+
+#include <array>
+
+namespace
+{
+
+// Passed pawns are scored by how far they've advanced, on top of the square scores every pawn gets.
+constexpr std::array<int, la::board_side> passed_pawn_bonus = { 0, 5, 10, 20, 40, 0 };
+
+constexpr int isolated_pawn_penalty = 10;
+constexpr int doubled_pawn_penalty = 10; // For each pawn on a file after the first.
+constexpr int blocked_pawn_penalty = 5; // For a pawn with another pawn directly in front of it.
+
+// For each file, a bit for each row which holds one of the side's pawns.
+using PawnFiles = std::array<unsigned, la::board_side>;
+
+// The rows in front of a pawn from the player's perspective.
+unsigned rows_in_front(la::Colour col, int row)
+{
+  constexpr unsigned all_rows = (1u << la::board_side) - 1;
+  return col == la::Colour::WHITE ? all_rows & ~((2u << row) - 1) : (1u << row) - 1;
+}
+
+int side_score(la::Colour col, const PawnFiles& own, const PawnFiles& other)
+{
+  int score = 0;
+  for (int c = 0; c < la::board_side; c++)
+  {
+    if (own[c] == 0)
+    {
+      continue;
+    }
+
+    const bool has_left = c > 0, has_right = c < la::board_side - 1;
+    const unsigned own_neighbours = (has_left ? own[c - 1] : 0) | (has_right ? own[c + 1] : 0);
+    const unsigned other_nearby =
+      other[c] | (has_left ? other[c - 1] : 0) | (has_right ? other[c + 1] : 0);
+
+    score -= doubled_pawn_penalty * (__builtin_popcount(own[c]) - 1);
+
+    for (int r = 0; r < la::board_side; r++)
+    {
+      if (!(own[c] >> r & 1))
+      {
+        continue;
+      }
+
+      if (own_neighbours == 0)
+      {
+        score -= isolated_pawn_penalty;
+      }
+
+      const int next_row = col == la::Colour::WHITE ? r + 1 : r - 1;
+      if (next_row >= 0 && next_row < la::board_side && ((own[c] | other[c]) >> next_row & 1))
+      {
+        score -= blocked_pawn_penalty;
+      }
+
+      if ((other_nearby & rows_in_front(col, r)) == 0)
+      {
+        score += passed_pawn_bonus[col == la::Colour::WHITE ? r : la::board_side - 1 - r];
+      }
+    }
+  }
+
+  return score;
+}
+
+}
+
+namespace la::detail
+{
+
+int pawn_structure_score(const la::Board& board)
+{
+  std::array<PawnFiles, 2> pawns = {};
+  for (int r = 0; r < la::board_side; r++)
+  {
+    for (int c = 0; c < la::board_side; c++)
+    {
+      const auto piece = board.get_piece(r, c);
+      if (piece &&
+          (piece->type == la::PieceType::PAWN_WHITE || piece->type == la::PieceType::PAWN_BLACK))
+      {
+        pawns[static_cast<int>(piece->colour)][c] |= 1u << r;
+      }
+    }
+  }
+
+  return
+    side_score(la::Colour::WHITE, pawns[0], pawns[1]) -
+    side_score(la::Colour::BLACK, pawns[1], pawns[0]);
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "engine/board.h"
+
+#include <cstdint>
+
+namespace la::detail
+{
+
+// Pawn structure scores are cached by Board::pawn_hash, which changes much less often than the
+// position does.
+struct PawnEntry
+{
+  std::uint64_t hash;
+  int score;
+};
+
+// The score for passed, isolated, doubled and blocked pawns from white's perspective. It only
+// depends on where the pawns are.
+int pawn_structure_score(const la::Board&);
+
+}
@@ -0,0 +1,206 @@
+#include "search/pool.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+namespace la
+{
+
+namespace
+{
+
+SearchResult run_search(Board& board, const SearchLimits& limits, const SearchParams& params)
+{
+  SearchResult result = {};
+  if (board.get_moves().empty())
+  {
+    return result;
+  }
+
+  result.best_move = search(board, limits, [&result] (const SearchData& data)
+  {
+    result.data = data;
+  }, params);
+
+  return result;
+}
+
+}
+
+SearchPool::SearchPool(unsigned num_threads)
+{
+  num_threads = std::max(1u, num_threads);
+  threads_.reserve(num_threads);
+  for (unsigned i = 0; i < num_threads; i++)
+  {
+    threads_.emplace_back(&SearchPool::thread_func, this);
+  }
+}
+
+SearchPool::~SearchPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+
+  work_cv_.notify_all();
+  for (auto& thread : threads_)
+  {
+    thread.join();
+  }
+}
+
+std::future<SearchResult> SearchPool::submit(
+  const Board& board,
+  const SearchLimits& limits,
+  const SearchParams& params)
+{
+  // std::function needs a copyable target, so the task is shared.
+  auto task = std::make_shared<std::packaged_task<SearchResult()>>(
+    [board = Board(board), limits, params] () mutable
+    {
+      return run_search(board, limits, params);
+    });
+
+  auto result = task->get_future();
+  enqueue([task] { (*task)(); });
+  return result;
+}
+
+void SearchPool::submit(
+  const Board& board,
+  const SearchLimits& limits,
+  std::function<void(const SearchResult&)> on_complete,
+  const SearchParams& params)
+{
+  enqueue([board = Board(board), limits, on_complete = std::move(on_complete), params] () mutable
+  {
+    SearchResult result = {};
+    try
+    {
+      result = run_search(board, limits, params);
+    }
+    catch (...)
+    {
+      result = {};
+      result.error = std::current_exception();
+    }
+
+    on_complete(result);
+  });
+}
+
+std::vector<std::future<SearchResult>> SearchPool::search_many(
+  const std::vector<Board>& positions,
+  const SearchLimits& limits,
+  const SearchParams& params)
+{
+  std::vector<std::future<SearchResult>> results;
+  results.reserve(positions.size());
+  for (const auto& board : positions)
+  {
+    results.push_back(submit(board, limits, params));
+  }
+
+  return results;
+}
+
+void SearchPool::search_many(
+  const std::vector<Board>& positions,
+  const SearchLimits& limits,
+  std::function<void(std::size_t, const SearchResult&)> on_complete,
+  const SearchParams& params)
+{
+  for (std::size_t i = 0; i < positions.size(); i++)
+  {
+    submit(positions[i], limits, [i, on_complete] (const SearchResult& result)
+    {
+      on_complete(i, result);
+    }, params);
+  }
+}
+
+void SearchPool::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this] { return jobs_.empty() && num_busy_ == 0; });
+  if (error_)
+  {
+    std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+}
+
+void SearchPool::enqueue(std::function<void()> job)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+
+  work_cv_.notify_one();
+}
+
+void SearchPool::thread_func()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    work_cv_.wait(lock, [this] { return !jobs_.empty() || quit_; });
+    if (jobs_.empty())
+    {
+      return;
+    }
+
+    auto job = std::move(jobs_.front());
+    jobs_.pop_front();
+    ++num_busy_;
+
+    // An exception mustn't end the thread, which would terminate the process.
+    lock.unlock();
+    std::exception_ptr job_error;
+    try
+    {
+      job();
+    }
+    catch (...)
+    {
+      job_error = std::current_exception();
+    }
+
+    lock.lock();
+
+    if (job_error && !error_)
+    {
+      error_ = job_error;
+    }
+
+    --num_busy_;
+    if (jobs_.empty() && num_busy_ == 0)
+    {
+      idle_cv_.notify_all();
+    }
+  }
+}
+
+std::vector<SearchResult> search_many(
+  const std::vector<Board>& positions,
+  const SearchLimits& limits,
+  const SearchParams& params)
+{
+  static SearchPool pool;
+
+  auto futures = pool.search_many(positions, limits, params);
+
+  std::vector<SearchResult> results;
+  results.reserve(futures.size());
+  for (auto& future : futures)
+  {
+    results.push_back(future.get());
+  }
+
+  return results;
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "engine/board.h"
+
+namespace la::detail
+{
+
+// The score of the position from the player to move's perspective after resolving captures with
+// a quiescence search of up to `depth` plies.
+int quiescence_score(la::Board&, int depth);
+
+}
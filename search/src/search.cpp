@@ -1,30 +1,272 @@
 #include "search/search.h"
+#include "search/mate.h"
+#include "search/time_manager.h"
+#include "pawns.h"
+#include "quiescence.h"
+#include "tt_entry.h"
+#include "engine/book.h"
+#include "engine/endgame.h"
+#include "engine/instrument.h"
+#include "engine/nnue.h"
+#include "engine/tablebase.h"
 #include "engine/tt.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
 #include <utility>
+#include <vector>
 
 namespace
 {
 
 using Clock = std::chrono::steady_clock;
 
-Clock::time_point current_search_end_time;
-std::uint64_t num_nodes_searched;
+// Iterative deepening stops here even without a limit, e.g. in a dead drawn position.
+constexpr int max_search_depth = 64;
 
-struct Entry
+// The search state is per thread so that independent searches can run concurrently.
+thread_local Clock::time_point current_search_end_time;
+thread_local std::uint64_t num_nodes_searched;
+thread_local std::uint64_t num_nodes_in_previous_iterations;
+thread_local std::uint64_t current_search_node_limit;
+thread_local la::SearchParams params;
+
+// Either flag being set ends the search: a stop requested by the caller, or another thread
+// having found a forced mate.
+thread_local const std::atomic<bool>* stop_requested;
+thread_local const std::atomic<bool>* mate_found;
+
+// The table's generation for this search, so that entries left by earlier searches can be replaced.
+// Searches in other processes sharing the table take generations too, so entries from a few
+// generations either side may be from searches still running, and count as recent.
+constexpr int shared_recent_generations = 4;
+thread_local std::uint32_t current_search_age;
+thread_local int recent_generations;
+
+// Statistics for SearchData, accumulated over the whole search.
+struct Statistics
 {
-  std::uint64_t hash;
-  int depth;
-  int score;
-  la::Move hash_move;
+  std::uint64_t quiescence_nodes;
+  std::uint64_t tt_probes;
+  std::uint64_t tt_hits;
+  std::uint64_t pawn_probes;
+  std::uint64_t pawn_hits;
+  std::uint64_t cutoffs;
+  std::uint64_t first_move_cutoffs;
+  int root_ply;
+  int seldepth;
+};
+
+thread_local Statistics stats;
+
+// Lazy SMP helpers add their counts to these so that SearchData and the node limit cover every
+// thread. Each helper publishes what it's counted every `publish_interval` nodes, and the rest
+// when it finishes.
+struct HelperCounts
+{
+  std::atomic<std::uint64_t> nodes{0};
+  std::atomic<std::uint64_t> quiescence_nodes{0};
+  std::atomic<std::uint64_t> tt_probes{0};
+  std::atomic<std::uint64_t> tt_hits{0};
+};
+
+constexpr std::uint64_t publish_interval = 1024;
+
+// The counts for the search this thread is running, if it has helpers, or the counts this thread
+// publishes to if it is a helper.
+thread_local HelperCounts* helper_counts;
+thread_local bool is_helper;
+
+// What a helper has published so far in this search.
+thread_local std::uint64_t published_nodes;
+thread_local Statistics published_stats;
+
+std::uint64_t helper_nodes()
+{
+  return helper_counts && !is_helper ? helper_counts->nodes.load(std::memory_order_relaxed) : 0;
+}
+
+void publish_counts()
+{
+  helper_counts->nodes.fetch_add(num_nodes_searched - published_nodes, std::memory_order_relaxed);
+  helper_counts->quiescence_nodes.fetch_add(
+    stats.quiescence_nodes - published_stats.quiescence_nodes, std::memory_order_relaxed);
+  helper_counts->tt_probes.fetch_add(
+    stats.tt_probes - published_stats.tt_probes, std::memory_order_relaxed);
+  helper_counts->tt_hits.fetch_add(
+    stats.tt_hits - published_stats.tt_hits, std::memory_order_relaxed);
+
+  published_nodes = num_nodes_searched;
+  published_stats = stats;
+}
+
+// Mate scores in the search count plies from the root, so that nearer mates score higher. Scores
+// from the table and tablebases count plies from the node instead, since a node can be reached at
+// different plies.
+int ply_from_root(const la::Board& board)
+{
+  return board.game_ply() - stats.root_ply;
+}
+
+int to_root_relative(int score, int ply)
+{
+  if (score >= la::eval::mate_score - la::mate_window) return score - ply;
+  if (score <= -la::eval::mate_score + la::mate_window) return score + ply;
+  return score;
+}
+
+int to_node_relative(int score, int ply)
+{
+  if (score >= la::eval::mate_score - la::mate_window) return score + ply;
+  if (score <= -la::eval::mate_score + la::mate_window) return score - ply;
+  return score;
+}
+
+// Each level of recursion generates its moves into its own list. The lists are kept for the life
+// of the thread, so once they've grown move generation never allocates. A deque keeps the lists
+// in place as more levels are added.
+thread_local std::deque<std::vector<la::Move>> move_lists;
+thread_local std::size_t num_move_lists_in_use;
+
+class MoveList
+{
+public:
+  MoveList()
+  {
+    if (num_move_lists_in_use == move_lists.size())
+    {
+      move_lists.emplace_back().reserve(64);
+    }
+
+    moves_ = &move_lists[num_move_lists_in_use++];
+  }
+
+  ~MoveList() { --num_move_lists_in_use; }
+
+  MoveList(const MoveList&) = delete;
+  MoveList& operator=(const MoveList&) = delete;
+
+  std::vector<la::Move>& operator*() { return *moves_; }
+
+private:
+  std::vector<la::Move>* moves_;
 };
 
-using Table = la::TT<Entry, 2000000>;
+using la::detail::Entry;
+using la::detail::EntryData;
+
+using Table = la::TT<Entry>;
+
+std::size_t table_entries(std::size_t size_mb)
+{
+  return size_mb * 1024 * 1024 / sizeof(Entry);
+}
+
+// Each thread keeps its table between searches, which saves reallocating it for every move when a
+// thread plays whole games. A table loaded from a snapshot keeps the snapshot's size until a later
+// search asks for a different size from the first search after loading.
+thread_local std::optional<Table> thread_table;
+thread_local std::size_t requested_table_entries;
+thread_local bool table_loaded;
+
+Table& table_for(const la::SearchParams& search_params)
+{
+  const auto num_entries = table_entries(search_params.hash_size_mb);
+  if (!thread_table)
+  {
+    thread_table.emplace(num_entries);
+    requested_table_entries = num_entries;
+  }
+
+  if (table_loaded)
+  {
+    requested_table_entries = num_entries;
+    table_loaded = false;
+  }
+
+  auto& table = *thread_table;
+  if (num_entries != requested_table_entries ||
+      table.shared_name() != search_params.shared_hash_name)
+  {
+    if (search_params.shared_hash_name.empty())
+    {
+      table.resize(num_entries);
+    }
+    else
+    {
+      table.attach(search_params.shared_hash_name, num_entries);
+    }
+
+    requested_table_entries = num_entries;
+  }
+
+  return table;
+}
+
+bool is_set(const std::atomic<bool>* flag)
+{
+  return flag && flag->load(std::memory_order_relaxed);
+}
 
 bool in_time()
 {
-  return Clock::now() < current_search_end_time;
+  if (is_helper && num_nodes_searched - published_nodes >= publish_interval)
+  {
+    publish_counts();
+  }
+
+  return Clock::now() < current_search_end_time &&
+    !is_set(stop_requested) &&
+    !is_set(mate_found) &&
+    (current_search_node_limit == 0 ||
+     num_nodes_in_previous_iterations + num_nodes_searched + helper_nodes() <
+       current_search_node_limit);
+}
+
+// Each thread keeps a small table of pawn structure scores for the life of the thread.
+constexpr std::size_t pawn_table_entries = 1 << 14;
+thread_local la::TT<la::detail::PawnEntry> pawn_table(pawn_table_entries);
+
+// The pawn structure score from the player to move's perspective.
+int pawn_score(const la::Board& board)
+{
+  ++stats.pawn_probes;
+
+  la::detail::PawnEntry* entry;
+  if (pawn_table.probe(board.pawn_hash(), &entry))
+  {
+    ++stats.pawn_hits;
+  }
+  else
+  {
+    *entry = { board.pawn_hash(), la::detail::pawn_structure_score(board) };
+  }
+
+  return board.player_to_move() == la::Colour::WHITE ? entry->score : -entry->score;
+}
+
+// The static evaluation of the position: endgame recognisers can replace the board's own score.
+// A network's evaluation already accounts for the pawn structure.
+int evaluate(const la::Board& board, const la::endgame::Recogniser* recogniser)
+{
+  if (recogniser && recogniser->type == la::endgame::RecogniserType::EVALUATE)
+  {
+    return recogniser->evaluate(board);
+  }
+
+  return la::nnue::loaded() ? board.score() : board.score() + pawn_score(board);
+}
+
+bool is_recognised_draw(const la::endgame::Recogniser* recogniser)
+{
+  return recogniser && recogniser->type == la::endgame::RecogniserType::DRAW;
 }
 
 // Search only the dynamic moves to try and get to a quiet position.
@@ -32,13 +274,22 @@ bool in_time()
 int quiesce(la::Board& board, int depth, int alpha, int beta)
 {
   ++num_nodes_searched;
+  ++stats.quiescence_nodes;
+  stats.seldepth = std::max(stats.seldepth, board.game_ply() - stats.root_ply);
+  LA_COUNT(QUIESCE);
 
+  const auto* recogniser = la::endgame::probe(board);
+  if (is_recognised_draw(recogniser))
+  {
+    return 0;
+  }
+
+  const int stand_pat = evaluate(board, recogniser);
   if (depth == 0)
   {
-    return board.score();
+    return stand_pat;
   }
 
-  const int stand_pat = board.score();
   if (stand_pat >= beta)
   {
     return beta;
@@ -49,8 +300,9 @@ int quiesce(la::Board& board, int depth, int alpha, int beta)
     alpha = stand_pat;
   }
 
-  auto moves = board.get_moves(
-    board.in_check() ? la::MoveGenType::ALL : la::MoveGenType::DYNAMIC);
+  MoveList move_list;
+  auto& moves = *move_list;
+  board.get_moves(moves, board.in_check() ? la::MoveGenType::ALL : la::MoveGenType::DYNAMIC);
 
   // Prioritise captures which are most valuable.
   std::size_t prioritised_index = 0;
@@ -82,10 +334,30 @@ int quiesce(la::Board& board, int depth, int alpha, int beta)
   return alpha;
 }
 
-int minimax(la::Board& board, int depth, int alpha, int beta, Table& table, int num_extensions = 0)
+int minimax(
+  la::Board& board,
+  int depth,
+  int alpha,
+  int beta,
+  Table& table,
+  int num_extensions = 0,
+  la::Move excluded_move = 0,
+  bool null_allowed = true)
 {
   static constexpr int max_extensions = 3;
 
+  // Don't search positions whose result is already known.
+  const auto* recogniser = la::endgame::probe(board);
+  if (is_recognised_draw(recogniser))
+  {
+    return 0;
+  }
+
+  if (const auto tablebase_score = la::tablebase::probe(board))
+  {
+    return to_root_relative(*tablebase_score, ply_from_root(board));
+  }
+
   if (depth == 0)
   {
     // If we're in check then we don't want to stop yet.
@@ -97,43 +369,90 @@ int minimax(la::Board& board, int depth, int alpha, int beta, Table& table, int
     return quiesce(board, 5, alpha, beta);
   }
 
+  const bool in_check = board.in_check();
+  const int static_score = evaluate(board, recogniser);
+  const bool near_mate =
+    std::abs(alpha) >= la::eval::mate_score / 2 || std::abs(beta) >= la::eval::mate_score / 2;
+
   // Null move pruning: if we're already doing well, and still are after passing, then
-  // return beta.
-  if (depth > 3 && board.score() >= beta && !board.in_check())
+  // return beta. Two null moves in a row would just search the same position shallower.
+  if (depth >= params.null_move_min_depth &&
+      null_allowed &&
+      excluded_move == 0 &&
+      static_score >= beta &&
+      !in_check)
   {
+    const int reduction = params.null_move_reduction + depth / params.null_move_depth_divisor;
+    const int null_depth = std::max(0, depth - 1 - reduction);
+
+    LA_COUNT(NULL_MOVE_ATTEMPT);
     board.make_null_move();
-    int null_score = -minimax(board, depth - 4, -beta, -alpha, table, num_extensions);
+    int null_score = -minimax(board, null_depth, -beta, -alpha, table, num_extensions, 0, false);
     board.undo_null_move();
 
     if (null_score >= beta)
     {
-      return beta;
+      // Deep cut-offs are verified without null moves to guard against zugzwang.
+      if (depth < params.null_move_verification_depth ||
+          minimax(board, null_depth, beta - 1, beta, table, num_extensions, 0, false) >= beta)
+      {
+        LA_COUNT(NULL_MOVE_CUTOFF);
+        return beta;
+      }
     }
   }
 
   // Reverse futility pruning: if at low depth the current player is doing very well then assume
   // we will be able to exceed the upper bound.
-  constexpr std::array<int, 4> rft_margin = { 0, 0, 100, 200 };
-  if (depth < 4 && !board.in_check() && board.score() > beta + rft_margin[depth])
+  if (depth <= params.reverse_futility_max_depth &&
+      excluded_move == 0 &&
+      !in_check &&
+      static_score > beta + params.reverse_futility_margin * (depth - 1))
   {
     return beta;
   }
 
   ++num_nodes_searched;
+  const int ply = ply_from_root(board);
+  stats.seldepth = std::max(stats.seldepth, ply);
 
   la::Move hash_move = 0;
-  Entry* entry;
-  if (table.probe(board.hash(), &entry))
+  int hash_depth = 0, hash_score = 0;
+  Entry* entry = table.slot(board.hash());
+  ++stats.tt_probes;
+  LA_COUNT(TT_PROBE);
+  if (const auto entry_data = entry->load(board.hash()))
   {
-    if (entry->depth >= depth)
+    ++stats.tt_hits;
+    LA_COUNT(TT_HIT);
+
+    // The stored score includes the excluded move, so it can't be used to raise alpha here.
+    if (entry_data->depth >= depth && excluded_move == 0)
     {
-      alpha = std::max(alpha, entry->score);
+      alpha = std::max(alpha, to_root_relative(entry_data->score, ply));
     }
 
-    hash_move = entry->hash_move;
+    hash_move = board.from_compact(entry_data->hash_move);
+    hash_depth = entry_data->depth;
+    hash_score = to_root_relative(entry_data->score, ply);
   }
 
-  auto moves = board.get_moves();
+  if (hash_move == 0 && depth >= params.iid_min_depth && excluded_move == 0)
+  {
+    minimax(board, depth - params.iid_reduction, alpha, beta, table, num_extensions);
+    LA_COUNT(TT_PROBE);
+    if (const auto entry_data = entry->load(board.hash()))
+    {
+      LA_COUNT(TT_HIT);
+      hash_move = board.from_compact(entry_data->hash_move);
+      hash_depth = entry_data->depth;
+      hash_score = to_root_relative(entry_data->score, ply);
+    }
+  }
+
+  MoveList move_list;
+  auto& moves = *move_list;
+  board.get_moves(moves);
   if (moves.empty())
   {
     if (board.is_draw())
@@ -141,10 +460,10 @@ int minimax(la::Board& board, int depth, int alpha, int beta, Table& table, int
       // Draw by repetition.
       return 0;
     }
-    else if (board.in_check())
+    else if (in_check)
     {
       // Checkmate.
-      return -la::eval::mate_score;
+      return -la::eval::mate_score + ply;
     }
     else
     {
@@ -177,45 +496,376 @@ int minimax(la::Board& board, int depth, int alpha, int beta, Table& table, int
     }
   }
 
+  // ProbCut: if a capture beats beta by a margin in a reduced search then it very likely beats beta
+  // in a full depth search too.
+  if (depth >= params.probcut_min_depth && excluded_move == 0 && !in_check && !near_mate)
+  {
+    const int probcut_beta = beta + params.probcut_margin;
+    for (const auto move : moves)
+    {
+      if (la::move::get_cap(move) == la::PieceType::NONE) continue;
+
+      board.make_move(move);
+      const int probcut_score = -minimax(
+        board, depth - params.probcut_reduction, -probcut_beta, -probcut_beta + 1, table, num_extensions);
+      board.undo_move(move);
+
+      if (probcut_score >= probcut_beta)
+      {
+        return beta;
+      }
+    }
+  }
+
+  // Check whether the hash move is singular: search the alternatives at reduced depth against a
+  // bound below the hash move's score, and if they all fail low then extend the hash move.
+  int singular_extension = 0;
+  if (hash_move != 0 &&
+      excluded_move == 0 &&
+      depth >= params.singular_min_depth &&
+      hash_depth >= depth - 3 &&
+      num_extensions < max_extensions &&
+      std::abs(hash_score) < la::eval::mate_score / 2 &&
+      std::find(moves.begin(), moves.end(), hash_move) != moves.end())
+  {
+    const int singular_beta = hash_score - params.singular_margin_per_ply * depth;
+    const int singular_score = minimax(
+      board, (depth - 1) / 2, singular_beta - 1, singular_beta, table, num_extensions, hash_move);
+
+    if (singular_score < singular_beta)
+    {
+      singular_extension = 1;
+    }
+  }
+
+  // Frontier futility pruning: near the leaves, quiet moves can't recover a position which is well
+  // below alpha. Late move pruning: quiet moves ordered after many others rarely matter.
+  const bool futile =
+    depth <= params.futility_max_depth &&
+    !in_check &&
+    !near_mate &&
+    static_score + params.futility_margin * depth <= alpha;
+
+  const int late_move_count =
+    depth <= params.late_move_max_depth && !in_check
+      ? params.late_move_base + depth * depth
+      : static_cast<int>(moves.size());
+
   int best_score = -la::eval::mate_score, score;
-  la::Move cutoff_move = 0;
+  int num_moves_searched = 0;
+  la::Move best_move = 0;
   for (const auto move : moves)
   {
+    if (move == excluded_move)
+    {
+      continue;
+    }
+
     // Return early if we're out of time.
     if (!in_time())
     {
       return 0;
     }
 
+    const bool is_quiet =
+      la::move::get_cap(move) == la::PieceType::NONE &&
+      la::move::get_promo(move) == la::PieceType::NONE;
+
+    const bool prunable =
+      is_quiet &&
+      num_moves_searched > 0 &&
+      (futile || num_moves_searched >= late_move_count);
+
+    const int extension = move == hash_move ? singular_extension : 0;
+
     board.make_move(move);
-    score = -minimax(board, depth - 1, -beta, -alpha, table, num_extensions);
+
+    // Moves which give check are never pruned.
+    if (prunable && !board.in_check())
+    {
+      board.undo_move(move);
+      continue;
+    }
+
+    score = -minimax(board, depth - 1 + extension, -beta, -alpha, table, num_extensions + extension);
     board.undo_move(move);
 
+    ++num_moves_searched;
+
     if (score > best_score)
     {
       best_score = score;
     }
 
-    alpha = std::max(alpha, best_score);
+    if (best_score > alpha)
+    {
+      alpha = best_score;
+      best_move = move;
+    }
+
     if (alpha >= beta)
     {
       // Cut-off
-      cutoff_move = move;
+      ++stats.cutoffs;
+      stats.first_move_cutoffs += num_moves_searched == 1;
+      LA_COUNT_CUTOFF(num_moves_searched - 1);
       break;
     }
   }
 
-  if (depth > entry->depth)
+  // Searches which exclude a move don't describe the node, so they mustn't be stored.
+  // Store the move which raised alpha so that later searches (including IID) have a hash move.
+  const EntryData entry_data =
+    { depth, to_node_relative(alpha, ply), la::move::to_compact(best_move), current_search_age };
+
+  if (excluded_move == 0 && entry->store(board.hash(), entry_data, recent_generations))
   {
-    entry->hash = board.hash();
-    entry->depth = depth;
-    entry->score = alpha;
-    entry->hash_move = cutoff_move;
+    LA_COUNT(TT_STORE);
   }
 
   return best_score;
 }
 
+// Lazy SMP: helper threads search the same position without reporting, sharing the main thread's
+// table. Starting at different depths and trying the root moves in different orders spreads them
+// across the tree, and their results reach the main thread through the table.
+void helper_search(
+  la::Board& board,
+  const la::SearchParams& search_params,
+  Table* table,
+  std::uint32_t search_age,
+  int helper_index,
+  const std::atomic<bool>* stop,
+  HelperCounts* counts)
+{
+  current_search_end_time = Clock::time_point::max();
+  current_search_node_limit = 0;
+  num_nodes_in_previous_iterations = 0;
+  num_nodes_searched = 0;
+  params = search_params;
+  current_search_age = search_age;
+  recent_generations = table->shared_name().empty() ? 1 : shared_recent_generations;
+  stats = Statistics();
+  stats.root_ply = board.game_ply();
+  stop_requested = stop;
+  mate_found = nullptr;
+  helper_counts = counts;
+  is_helper = true;
+  published_nodes = 0;
+  published_stats = Statistics();
+
+  auto moves = board.get_moves();
+  std::rotate(moves.begin(), moves.begin() + helper_index % moves.size(), moves.end());
+
+  for (int depth = 1 + helper_index % 2; in_time() && depth <= max_search_depth; depth++)
+  {
+    for (const auto move : moves)
+    {
+      if (!in_time()) break;
+
+      board.make_move(move);
+      minimax(board, depth - 1, -la::eval::mate_score, la::eval::mate_score, *table);
+      board.undo_move(move);
+    }
+  }
+
+  publish_counts();
+  stop_requested = nullptr;
+  helper_counts = nullptr;
+  is_helper = false;
+  LA_AGGREGATE();
+}
+
+// The helpers are kept for the life of the thread which started them, parked between searches so
+// that starting a search doesn't start threads.
+class HelperPool
+{
+public:
+  ~HelperPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+
+    cv_.notify_all();
+    for (auto& thread : threads_)
+    {
+      thread.join();
+    }
+  }
+
+  // Start `count` helpers searching the position until `stop` is set.
+  void start(
+    int count,
+    const la::Board& board,
+    const la::SearchParams& search_params,
+    Table* table,
+    std::uint32_t search_age,
+    const std::atomic<bool>* stop,
+    HelperCounts* counts)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (static_cast<int>(threads_.size()) < count)
+    {
+      threads_.emplace_back(&HelperPool::thread_func, this, static_cast<int>(threads_.size()) + 1);
+    }
+
+    board_ = board;
+    params_ = &search_params;
+    table_ = table;
+    search_age_ = search_age;
+    stop_ = stop;
+    counts_ = counts;
+    num_active_ = count;
+    num_running_ = count;
+    ++generation_;
+    cv_.notify_all();
+  }
+
+  // Block until every helper has finished.
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return num_running_ == 0; });
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::thread> threads_;
+  std::uint64_t generation_ = 0;
+  int num_active_ = 0, num_running_ = 0;
+  bool quit_ = false;
+
+  la::Board board_;
+  const la::SearchParams* params_;
+  Table* table_;
+  std::uint32_t search_age_;
+  const std::atomic<bool>* stop_;
+  HelperCounts* counts_;
+
+  void thread_func(int helper_index)
+  {
+    la::Board board;
+    std::uint64_t generation = 0;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      cv_.wait(lock, [&]
+      {
+        return quit_ || (generation != generation_ && helper_index <= num_active_);
+      });
+
+      if (quit_)
+      {
+        return;
+      }
+
+      generation = generation_;
+      board = board_;
+
+      lock.unlock();
+      helper_search(board, *params_, table_, search_age_, helper_index, stop_, counts_);
+      lock.lock();
+
+      if (--num_running_ == 0)
+      {
+        cv_.notify_all();
+      }
+    }
+  }
+};
+
+thread_local HelperPool helpers;
+
+// Runs the mate solver alongside the search. Its thread is started the first time it's needed
+// and parked between searches, and it keeps the solver's table so later searches reuse its work.
+class MateSolverThread
+{
+public:
+  ~MateSolverThread()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+
+    cv_.notify_all();
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+  // Start looking for a mate. `found` is set once the solver has finished, to whether it found one.
+  void start(const la::Board& board, int max_plies, std::atomic<bool>* found)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable())
+    {
+      thread_ = std::thread(&MateSolverThread::thread_func, this);
+    }
+
+    board_ = board;
+    max_plies_ = max_plies;
+    found_ = found;
+    stop_.store(false);
+    result_.reset();
+    running_ = true;
+    cv_.notify_all();
+  }
+
+  // Stop the solver if it's still running and return any mate it found.
+  std::optional<la::MateResult> stop()
+  {
+    stop_.store(true);
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !running_; });
+    return result_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool running_ = false, quit_ = false;
+
+  la::MateSolver solver_;
+  la::Board board_;
+  int max_plies_ = 0;
+  std::atomic<bool>* found_ = nullptr;
+  std::atomic<bool> stop_{false};
+  std::optional<la::MateResult> result_;
+
+  void thread_func()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      cv_.wait(lock, [this] { return running_ || quit_; });
+      if (quit_)
+      {
+        return;
+      }
+
+      la::Board board = board_;
+      lock.unlock();
+      const auto result = solver_.find(board, max_plies_, &stop_);
+      LA_AGGREGATE();
+      found_->store(result.has_value());
+      lock.lock();
+
+      result_ = result;
+      running_ = false;
+      cv_.notify_all();
+    }
+  }
+};
+
+thread_local MateSolverThread mate_solver;
+
 }
 
 namespace la
@@ -224,20 +874,108 @@ namespace la
 Move search(
   la::Board& board,
   std::chrono::milliseconds timeout,
-  std::function<void(const SearchData&)> callback)
+  std::function<void(const SearchData&)> callback,
+  const SearchParams& search_params)
 {
+  SearchLimits limits;
+  limits.time = timeout;
+  return search(board, limits, callback, search_params);
+}
+
+Move search(
+  la::Board& board,
+  const SearchLimits& limits,
+  std::function<void(const SearchData&)> callback,
+  const SearchParams& search_params)
+{
+  // Play straight from the book when we can.
+  if (const auto entry = book::probe(board))
+  {
+    callback(SearchData { 0, entry->score, entry->move, 0, std::chrono::milliseconds(0) });
+    return entry->move;
+  }
+
   const auto start_time = Clock::now();
-  current_search_end_time = start_time + timeout;
+  current_search_end_time = limits.time.count() > 0
+    ? start_time + limits.time
+    : Clock::time_point::max();
+
+  current_search_node_limit = limits.nodes;
+  stop_requested = limits.stop;
+  num_nodes_in_previous_iterations = 0;
+  num_nodes_searched = 0;
+  params = search_params;
+  stats = Statistics();
+  stats.root_ply = board.game_ply();
 
   const auto moves = board.get_moves();
 
   assert(!moves.empty());
 
-  Table table;
-  int depth = 1, score, best_score, best_score_at_depth;
+  auto& table = table_for(params);
+  current_search_age = table.next_generation();
+  recent_generations = table.shared_name().empty() ? 1 : shared_recent_generations;
+
+  // Once we appear to have a mating attack the mate solver looks for a forced mate alongside the
+  // main search.
+  bool mate_solver_started = false;
+  std::atomic<bool> solver_found_mate{false};
+  std::optional<MateResult> mate;
+  mate_found = &solver_found_mate;
+
+  std::atomic<bool> stop_helpers{false};
+  HelperCounts counts;
+  if (params.threads > 1)
+  {
+    helper_counts = &counts;
+    helpers.start(
+      params.threads - 1, board, params, &table, current_search_age, &stop_helpers, &counts);
+  }
+
+  std::uint64_t num_nodes_in_previous_iteration = 0;
+  const auto make_data = [&] (int data_depth, int data_score, Move data_move)
+  {
+    const auto time_taken =
+      std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time);
+
+    // The helpers' counts are included in the totals, which may lag their progress a little.
+    const std::uint64_t tt_probes = stats.tt_probes + counts.tt_probes.load();
+    const std::uint64_t tt_hits = stats.tt_hits + counts.tt_hits.load();
+
+    SearchData data = { data_depth, data_score, data_move, num_nodes_searched, time_taken };
+    data.total_nodes = num_nodes_in_previous_iterations + num_nodes_searched + counts.nodes.load();
+    data.quiescence_nodes = stats.quiescence_nodes + counts.quiescence_nodes.load();
+    data.nodes_per_second = data.total_nodes * 1000 / std::max<std::int64_t>(1, time_taken.count());
+    data.seldepth = stats.seldepth;
+    data.tt_hit_rate = tt_probes > 0 ? double(tt_hits) / tt_probes : 0.0;
+    data.pawn_hit_rate = stats.pawn_probes > 0 ? double(stats.pawn_hits) / stats.pawn_probes : 0.0;
+    data.hashfull = table.hashfull([] (const Entry& entry)
+    {
+      return entry.in_use(current_search_age, recent_generations);
+    });
+
+    data.first_move_cutoff_rate =
+      stats.cutoffs > 0 ? double(stats.first_move_cutoffs) / stats.cutoffs : 0.0;
+    data.branching_factor = num_nodes_in_previous_iteration > 0
+      ? double(num_nodes_searched) / num_nodes_in_previous_iteration
+      : 0.0;
+
+    return data;
+  };
+
+  std::optional<TimeManager> time_manager;
+  if (limits.soft_time.count() > 0)
+  {
+    time_manager.emplace(
+      limits.soft_time,
+      limits.time.count() > 0 ? limits.time : limits.soft_time * 4);
+  }
+
+  int depth = 1, completed_depth = 0, score, best_score, best_score_at_depth;
   Move best_move = moves[0], best_move_at_depth = moves[0];
-  while (in_time())
+  while (in_time() && depth <= (limits.depth == 0 ? max_search_depth : limits.depth))
   {
+    num_nodes_in_previous_iterations += num_nodes_searched;
     num_nodes_searched = 0;
 
     // Try all available moves and keep track of the one with the highest score.
@@ -262,52 +1000,178 @@ Move search(
     {
       best_move = best_move_at_depth;
       best_score = best_score_at_depth;
+      completed_depth = depth;
 
-      const auto time_taken =
-        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time);
+      callback(make_data(depth, best_score, best_move));
+      num_nodes_in_previous_iteration = num_nodes_searched;
 
-      SearchData data = { depth, best_score, best_move, num_nodes_searched, time_taken };
-      callback(data);
+      if (!mate_solver_started &&
+          params.mate_solver_max_plies > 0 &&
+          best_score >= params.mate_solver_min_score &&
+          best_score < eval::mate_score - mate_window)
+      {
+        mate_solver.start(board, params.mate_solver_max_plies, &solver_found_mate);
+        mate_solver_started = true;
+      }
+
+      if (time_manager)
+      {
+        time_manager->iteration_complete(
+          Clock::now() - start_time, num_nodes_searched, best_move, best_score);
+
+        if (!time_manager->start_next_iteration(Clock::now() - start_time))
+        {
+          break;
+        }
+      }
     }
 
     ++depth;
   }
 
+  stop_helpers.store(true);
+  if (params.threads > 1)
+  {
+    helpers.wait();
+    helper_counts = nullptr;
+  }
+
+  if (mate_solver_started)
+  {
+    mate = mate_solver.stop();
+  }
+
+  stop_requested = nullptr;
+  mate_found = nullptr;
+  LA_AGGREGATE();
+
+  // The mate's length is in the score, which reports it as a mate.
+  if (mate)
+  {
+    best_move = mate->move;
+    callback(make_data(completed_depth, eval::mate_score - mate->plies, best_move));
+  }
+
   return best_move;
 }
 
+void save_table(const std::string& path, int min_depth)
+{
+  const auto& table = thread_table ? *thread_table : table_for(SearchParams());
+  if (min_depth == 0)
+  {
+    table.save(path);
+    return;
+  }
+
+  table.save(path, [min_depth] (Entry& entry)
+  {
+    entry.clear_below(min_depth);
+    return entry.max_depth() != 0;
+  });
+}
+
+void load_table(const std::string& path)
+{
+  if (!thread_table)
+  {
+    thread_table.emplace(1);
+  }
+
+  thread_table->load(path);
+  table_loaded = true;
+
+  // Entries from earlier searches are the first to be replaced, so the loaded entries must look
+  // like they're from the next search. Rewriting their ages would copy every page of a mapped
+  // snapshot, so instead the next search takes the age which most of them have, from a sample.
+  constexpr int sample_entries = 1000;
+  std::array<int, 256> age_counts = {};
+  int num_sampled = 0;
+  for (std::size_t i = 0; i < thread_table->size() && num_sampled < sample_entries; i++)
+  {
+    for (const auto& word : thread_table->slot(i)->words)
+    {
+      if (Entry::depth(word) != 0)
+      {
+        ++age_counts[Entry::age(word)];
+        ++num_sampled;
+      }
+    }
+  }
+
+  if (num_sampled > 0)
+  {
+    const auto most_common = std::max_element(age_counts.begin(), age_counts.end());
+    thread_table->set_generation(static_cast<std::uint32_t>(most_common - age_counts.begin()) - 1);
+  }
+}
+
 SearchWorker::SearchWorker(std::function<void(const SearchData&)> callback)
-  : callback_(callback), running_(false)
+  : callback_(callback), running_(false), worker_(&SearchWorker::search_worker_func, this)
 {
 }
 
 SearchWorker::~SearchWorker()
 {
-  if (worker_.joinable())
   {
-    worker_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
   }
+
+  cv_.notify_all();
+  worker_.join();
 }
 
 void SearchWorker::start(const la::Board& board, std::chrono::milliseconds timeout)
 {
+  SearchLimits limits;
+  limits.time = timeout;
+  start(board, limits);
+}
+
+void SearchWorker::start(const la::Board& board, const SearchLimits& limits)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return !has_work_; });
+
   running_.store(true);
 
   board_ = board;
-  timeout_ = timeout;
+  limits_ = limits;
+  has_work_ = true;
+  cv_.notify_all();
+}
 
-  if (worker_.joinable())
+void SearchWorker::search_worker_func()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
   {
-    worker_.join();
-  }
+    // Any search which has been started is finished before quitting.
+    cv_.wait(lock, [this] { return has_work_ || quit_; });
+    if (!has_work_)
+    {
+      return;
+    }
+
+    lock.unlock();
+    search(board_, limits_, callback_);
+    lock.lock();
 
-  worker_ = std::thread(&SearchWorker::search_worker_func, this);
+    has_work_ = false;
+    running_.store(false);
+    cv_.notify_all();
+  }
 }
 
-void SearchWorker::search_worker_func()
+namespace detail
 {
-  search(board_, timeout_, callback_);
-  running_.store(false);
+
+int quiescence_score(la::Board& board, int depth)
+{
+  return quiesce(board, depth, -eval::mate_score, eval::mate_score);
+}
+
 }
 
 }
@@ -0,0 +1,99 @@
+#include "search/time_manager.h"
+
+#include <algorithm>
+
+namespace la
+{
+
+namespace
+{
+
+// Allow for the time taken to communicate the move.
+constexpr std::chrono::milliseconds move_overhead{30};
+
+// Without a move count assume the game lasts this many more moves.
+constexpr int default_moves_to_go = 25;
+
+// Each change of best move extends the soft limit by this proportion, decaying each iteration.
+constexpr double instability_extension = 0.5;
+constexpr double instability_decay = 0.5;
+
+// A score which falls this many centipawns between iterations extends the soft limit by half.
+constexpr int score_drop_margin = 30;
+
+}
+
+TimeAllocation allocate_time(const TimeControl& tc)
+{
+  using std::chrono::milliseconds;
+
+  const auto available = std::max(milliseconds(1), tc.remaining - move_overhead);
+  const int moves_to_go = tc.moves_to_go > 0
+    ? std::min(tc.moves_to_go, default_moves_to_go)
+    : default_moves_to_go;
+
+  // Most of the increment can be spent as it will be returned after the move.
+  auto hard = std::min(available * 2 / 5, available / moves_to_go * 4 + tc.increment);
+  auto soft = std::min(available / moves_to_go + tc.increment * 3 / 4, hard);
+
+  // With one move to go the whole clock is available.
+  if (tc.moves_to_go == 1)
+  {
+    hard = available;
+    soft = available * 4 / 5;
+  }
+
+  return { std::max(milliseconds(1), soft), std::max(milliseconds(1), hard) };
+}
+
+TimeManager::TimeManager(std::chrono::milliseconds soft, std::chrono::milliseconds hard)
+  : soft_(soft), hard_(hard)
+{
+}
+
+void TimeManager::iteration_complete(
+  std::chrono::steady_clock::duration elapsed,
+  std::uint64_t iteration_nodes,
+  Move best_move,
+  int score)
+{
+  const auto iteration_time = elapsed - last_elapsed_;
+  if (last_iteration_nodes_ > 0)
+  {
+    branching_factor_ = double(iteration_nodes) / last_iteration_nodes_;
+  }
+
+  instability_ *= instability_decay;
+  if (num_iterations_ > 0 && best_move != best_move_)
+  {
+    instability_ += instability_extension;
+  }
+
+  score_drop_ = num_iterations_ > 0 && score < score_ - score_drop_margin ? 0.5 : 0.0;
+
+  last_elapsed_ = elapsed;
+  last_iteration_time_ = iteration_time;
+  last_iteration_nodes_ = iteration_nodes;
+  best_move_ = best_move;
+  score_ = score;
+  ++num_iterations_;
+}
+
+bool TimeManager::start_next_iteration(std::chrono::steady_clock::duration elapsed) const
+{
+  const auto soft = std::min(
+    hard_,
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      soft_ * (1.0 + instability_ + score_drop_)));
+
+  // Early iterations are too small to predict from, so keep going until the soft limit.
+  const double branching_factor = std::clamp(branching_factor_, 1.0, 10.0);
+  const auto predicted = num_iterations_ > 1
+    ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        last_iteration_time_ * branching_factor)
+    : std::chrono::steady_clock::duration(0);
+
+  return elapsed + predicted < soft;
+}
+
+}
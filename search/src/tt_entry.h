@@ -0,0 +1,199 @@
+#pragma once
+
+#include "search/search.h"
+#include "engine/board.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace la::detail
+{
+
+// The search's transposition table entries, which the microbenchmark times too.
+struct EntryData
+{
+  int depth;
+  int score;
+  la::CompactMove hash_move;
+  std::uint32_t age;
+};
+
+// Entries are packed into 64 bits and grouped in buckets filling a cache line, so a probe touches a
+// single line. Each entry is read and written as one atomic word, so the helper threads, and other
+// processes when the table is shared, can use the table without locks and never see a torn entry.
+// Bits 0-15: the top 16 bits of the hash (the bucket index supplies more)
+// Bits 16-31: the hash move
+// Bits 32-47: the score
+// Bits 48-55: the depth, which is zero for an empty entry
+// Bits 56-63: the low bits of the table generation of the search which stored it
+struct alignas(64) Entry
+{
+  static constexpr std::uint32_t layout_version = 2;
+  static constexpr int bucket_size = 8;
+
+  std::uint64_t words[bucket_size];
+
+  std::optional<EntryData> load(std::uint64_t position_hash) const
+  {
+    for (const auto& word : words)
+    {
+      const auto value = __atomic_load_n(&word, __ATOMIC_RELAXED);
+      if (key(value) == position_hash >> 48 && depth(value) != 0)
+      {
+        return decode(value);
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Entries from the last `recent_generations` generations, or from later ones, are recent. With a
+  // shared table other processes' searches take generations too, so an entry from another search
+  // running at the same time can be a generation or two either side of this search's.
+  static bool is_recent(std::uint8_t entry_age, std::uint8_t search_age, int recent_generations)
+  {
+    return static_cast<std::uint8_t>(search_age - entry_age) < recent_generations ||
+      static_cast<std::uint8_t>(entry_age - search_age) < recent_generations;
+  }
+
+  // An entry for the same position is replaced by a deeper search, or by one as deep from a later
+  // generation, but never by a shallower one. Otherwise the entry replaced is the shallowest of
+  // those which aren't recent, or else of the whole bucket. Returns whether the data was stored.
+  bool store(std::uint64_t position_hash, const EntryData& entry_data, int recent_generations = 1)
+  {
+    const auto entry_key = static_cast<std::uint16_t>(position_hash >> 48);
+    const auto entry_age = static_cast<std::uint8_t>(entry_data.age);
+
+    std::uint64_t* replace = &words[0];
+    int replace_value = std::numeric_limits<int>::max();
+    for (auto& word : words)
+    {
+      const auto value = __atomic_load_n(&word, __ATOMIC_RELAXED);
+      if (key(value) == entry_key && depth(value) != 0)
+      {
+        if (entry_data.depth < depth(value) ||
+            (entry_data.depth == depth(value) && age(value) == entry_age))
+        {
+          return false;
+        }
+
+        replace = &word;
+        break;
+      }
+
+      const int value_to_keep =
+        depth(value) + (is_recent(age(value), entry_age, recent_generations) ? 256 : 0);
+      if (value_to_keep < replace_value)
+      {
+        replace = &word;
+        replace_value = value_to_keep;
+      }
+    }
+
+    __atomic_store_n(replace, encode(entry_key, entry_data), __ATOMIC_RELAXED);
+    return true;
+  }
+
+  // The proportion of the bucket holding recent entries.
+  double in_use(std::uint32_t search_age, int recent_generations = 1) const
+  {
+    int used = 0;
+    for (const auto& word : words)
+    {
+      const auto value = __atomic_load_n(&word, __ATOMIC_RELAXED);
+      used += depth(value) != 0 &&
+        is_recent(age(value), static_cast<std::uint8_t>(search_age), recent_generations);
+    }
+
+    return double(used) / bucket_size;
+  }
+
+  // Empties the entries searched less deeply than the minimum depth.
+  void clear_below(int min_depth)
+  {
+    for (auto& word : words)
+    {
+      if (depth(__atomic_load_n(&word, __ATOMIC_RELAXED)) < min_depth)
+      {
+        __atomic_store_n(&word, 0, __ATOMIC_RELAXED);
+      }
+    }
+  }
+
+  int max_depth() const
+  {
+    int max = 0;
+    for (const auto& word : words)
+    {
+      max = std::max(max, depth(__atomic_load_n(&word, __ATOMIC_RELAXED)));
+    }
+
+    return max;
+  }
+
+  // Scores this close to mate are distances to mate, which are kept exact. Others are clamped to
+  // the range below them.
+  static constexpr int mate_window = la::mate_window;
+  static constexpr int max_stored_score = std::numeric_limits<std::int16_t>::max();
+
+  static std::int16_t to_stored_score(int score)
+  {
+    constexpr int mate_bound = la::eval::mate_score - mate_window;
+    if (score >= mate_bound)
+    {
+      return static_cast<std::int16_t>(max_stored_score - std::min(la::eval::mate_score - score, mate_window));
+    }
+
+    if (score <= -mate_bound)
+    {
+      return static_cast<std::int16_t>(-max_stored_score + std::min(la::eval::mate_score + score, mate_window));
+    }
+
+    constexpr int max_normal = max_stored_score - mate_window - 1;
+    return static_cast<std::int16_t>(std::clamp(score, -max_normal, max_normal));
+  }
+
+  static int from_stored_score(std::int16_t stored)
+  {
+    if (stored >= max_stored_score - mate_window)
+    {
+      return la::eval::mate_score - (max_stored_score - stored);
+    }
+
+    if (stored <= -max_stored_score + mate_window)
+    {
+      return -la::eval::mate_score + (stored + max_stored_score);
+    }
+
+    return stored;
+  }
+
+  static std::uint16_t key(std::uint64_t value) { return static_cast<std::uint16_t>(value); }
+  static int depth(std::uint64_t value) { return static_cast<std::uint8_t>(value >> 48); }
+  static std::uint8_t age(std::uint64_t value) { return static_cast<std::uint8_t>(value >> 56); }
+
+  static std::uint64_t encode(std::uint16_t entry_key, const EntryData& entry_data)
+  {
+    return
+      std::uint64_t(entry_key) |
+      std::uint64_t(entry_data.hash_move) << 16 |
+      std::uint64_t(static_cast<std::uint16_t>(to_stored_score(entry_data.score))) << 32 |
+      std::uint64_t(static_cast<std::uint8_t>(std::clamp(entry_data.depth, 1, 255))) << 48 |
+      std::uint64_t(static_cast<std::uint8_t>(entry_data.age)) << 56;
+  }
+
+  static EntryData decode(std::uint64_t value)
+  {
+    return
+    {
+      depth(value),
+      from_stored_score(static_cast<std::int16_t>(value >> 32)),
+      static_cast<la::CompactMove>(value >> 16),
+      age(value)
+    };
+  }
+};
+
+}
@@ -0,0 +1,172 @@
+#include "engine/book.h"
+#include "engine/records.h"
+#include "search/search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Build an opening book by searching every position the book could reach in its first plies.
+// Usage: bookgen <output file> <plies> [ms per position] [threads]
+// When the book plays a side it only follows its own chosen move, but must answer every reply, so
+// the positions are expanded separately for the book playing white and the book playing black.
+
+namespace
+{
+
+// Which sides the book is playing in a position.
+using Sides = std::uint8_t;
+constexpr Sides book_plays_white = 1;
+constexpr Sides book_plays_black = 2;
+
+Sides book_side(la::Colour col)
+{
+  return col == la::Colour::WHITE ? book_plays_white : book_plays_black;
+}
+
+struct Node
+{
+  la::Board board;
+  Sides sides;
+};
+
+// Search every node in parallel.
+std::vector<la::book::Entry> search_nodes(
+  const std::vector<Node>& nodes,
+  std::chrono::milliseconds time_per_position,
+  unsigned num_threads)
+{
+  std::vector<la::book::Entry> entries(nodes.size());
+  std::atomic<std::size_t> next_node{0};
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < num_threads; t++)
+  {
+    threads.emplace_back([&]
+    {
+      std::size_t i;
+      while ((i = next_node.fetch_add(1)) < nodes.size())
+      {
+        la::Board board = nodes[i].board;
+        int score = 0;
+        const auto move = la::search(board, time_per_position, [&score] (const la::SearchData& data)
+        {
+          score = data.score;
+        });
+
+        entries[i] = { board.hash(), move, score };
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  return entries;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "Usage: %s <output file> <plies> [ms per position] [threads]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const int num_plies = std::atoi(argv[2]);
+  const std::chrono::milliseconds time_per_position(argc > 3 ? std::atoi(argv[3]) : 1000);
+  const unsigned num_threads = argc > 4
+    ? static_cast<unsigned>(std::atoi(argv[4]))
+    : std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<la::book::Entry> book;
+  std::unordered_set<std::uint64_t> searched;
+
+  std::vector<Node> level = { Node { la::Board(), book_plays_white | book_plays_black } };
+  for (int ply = 0; ply < num_plies && !level.empty(); ply++)
+  {
+    const auto entries = search_nodes(level, time_per_position, num_threads);
+
+    // Expand the level: the book's own moves for the side it plays, and every move otherwise.
+    std::vector<Node> next_level;
+    std::unordered_map<std::uint64_t, std::size_t> next_index;
+    const auto add_child = [&] (la::Board& board, la::Move move, Sides sides)
+    {
+      board.make_move(move);
+      const auto hash = board.hash();
+      if (!searched.count(hash) && !board.get_moves().empty())
+      {
+        const auto it = next_index.find(hash);
+        if (it == next_index.end())
+        {
+          next_index[hash] = next_level.size();
+          next_level.push_back(Node { board, sides });
+        }
+        else
+        {
+          next_level[it->second].sides |= sides;
+        }
+      }
+
+      board.undo_move(move);
+    };
+
+    for (std::size_t i = 0; i < level.size(); i++)
+    {
+      auto& node = level[i];
+      const auto& entry = entries[i];
+      if (!searched.insert(entry.hash).second) continue;
+      book.push_back(entry);
+
+      const Sides to_move = book_side(node.board.player_to_move());
+      if (node.sides & to_move)
+      {
+        add_child(node.board, entry.move, to_move);
+      }
+
+      if (const Sides others = node.sides & ~to_move)
+      {
+        for (const auto move : node.board.get_moves())
+        {
+          add_child(node.board, move, others);
+        }
+      }
+    }
+
+    std::printf("Ply %d: %zu positions searched, %zu in the book\n", ply, level.size(), book.size());
+    std::fflush(stdout);
+
+    level = std::move(next_level);
+  }
+
+  std::sort(book.begin(), book.end(), [] (const la::book::Entry& lhs, const la::book::Entry& rhs)
+  {
+    return lhs.hash < rhs.hash;
+  });
+
+  try
+  {
+    la::RecordWriter<la::book::Entry> out(argv[1]);
+    out.write(book.data(), book.size());
+    out.close();
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "%s\n", e.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
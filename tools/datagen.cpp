@@ -0,0 +1,270 @@
+#include "engine/records.h"
+#include "search/search.h"
+#include "training_data.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Generate training data by playing the engine against itself.
+// Usage: datagen <output file> <num games> [nodes per move] [threads]
+// Each game starts with a few random moves and is then played out with node limited searches.
+// Quiet positions are written to a record file of TrainingRecords.
+
+namespace
+{
+
+constexpr int random_opening_plies = 8;
+constexpr int max_game_plies = 300;
+
+using Record = TrainingRecord;
+
+Record make_record(const la::Board& board, int score)
+{
+  Record record = {};
+  record.position = la::PackedPosition::from_board(board);
+
+  const bool white = board.player_to_move() == la::Colour::WHITE;
+  record.score = static_cast<std::int16_t>(std::clamp(white ? score : -score, -30000, 30000));
+  return record;
+}
+
+// Finished games are queued for a single writer thread, so workers only ever wait on the lock.
+class GameQueue
+{
+public:
+  void push(std::vector<Record>&& game)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      games_.push_back(std::move(game));
+    }
+
+    cv_.notify_one();
+  }
+
+  // Blocks until a game is available. Returns false once the queue is closed and empty.
+  bool pop(std::vector<Record>& game)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !games_.empty() || closed_; });
+    if (games_.empty())
+    {
+      return false;
+    }
+
+    game = std::move(games_.front());
+    games_.pop_front();
+    return true;
+  }
+
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+
+    cv_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::vector<Record>> games_;
+  bool closed_ = false;
+};
+
+// Play random moves from the start position. Returns false if the game ended before the end of
+// the opening.
+bool play_random_opening(la::Board& board, std::mt19937_64& rng)
+{
+  for (int ply = 0; ply < random_opening_plies; ply++)
+  {
+    const auto moves = board.get_moves();
+    if (moves.empty())
+    {
+      return false;
+    }
+
+    board.make_move(moves[rng() % moves.size()]);
+  }
+
+  return !board.get_moves().empty();
+}
+
+std::vector<Record> play_game(std::uint64_t game_index, const la::SearchLimits& limits)
+{
+  // Short node limited searches don't leave time for the mate solver to be worth starting.
+  la::SearchParams params;
+  params.mate_solver_max_plies = 0;
+
+  std::mt19937_64 rng(game_index);
+
+  la::Board board;
+  while (!play_random_opening(board, rng))
+  {
+    board = la::Board();
+  }
+
+  std::vector<Record> records;
+  int result = 0, ply = 0;
+  for (; ply < max_game_plies; ply++)
+  {
+    const auto moves = board.get_moves();
+    if (moves.empty())
+    {
+      // Checkmate is a loss for the player to move, otherwise it's a draw.
+      if (!board.is_draw() && board.in_check())
+      {
+        result = board.player_to_move() == la::Colour::WHITE ? -1 : 1;
+      }
+
+      break;
+    }
+
+    la::SearchData last_data = {};
+    const auto move = la::search(board, limits, [&last_data] (const la::SearchData& data)
+    {
+      last_data = data;
+    }, params);
+
+    // Positions where the best move is tactical are poor examples for a static evaluation.
+    const bool quiet =
+      !board.in_check() &&
+      la::move::get_cap(move) == la::PieceType::NONE &&
+      la::move::get_promo(move) == la::PieceType::NONE;
+
+    if (quiet && last_data.depth > 0)
+    {
+      records.push_back(make_record(board, last_data.score));
+    }
+
+    board.make_move(move);
+  }
+
+  for (auto& record : records)
+  {
+    record.result = static_cast<std::int8_t>(result);
+  }
+
+  return records;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "Usage: %s <output file> <num games> [nodes per move] [threads]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const std::uint64_t num_games = std::strtoull(argv[2], nullptr, 10);
+
+  la::SearchLimits limits;
+  limits.nodes = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20000;
+
+  const unsigned num_threads = argc > 4
+    ? static_cast<unsigned>(std::atoi(argv[4]))
+    : std::max(1u, std::thread::hardware_concurrency());
+
+  std::unique_ptr<la::RecordWriter<Record>> out;
+  try
+  {
+    out = std::make_unique<la::RecordWriter<Record>>(argv[1]);
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "%s\n", e.what());
+    return EXIT_FAILURE;
+  }
+
+  GameQueue queue;
+
+  // Once a write fails the workers stop and the remaining games are discarded.
+  std::atomic<bool> write_failed{false};
+  std::uint64_t num_positions = 0, num_games_written = 0;
+  std::thread writer([&]
+  {
+    std::vector<Record> game;
+    while (queue.pop(game))
+    {
+      if (write_failed)
+      {
+        continue;
+      }
+
+      try
+      {
+        out->write(game.data(), game.size());
+      }
+      catch (const std::runtime_error& e)
+      {
+        std::fprintf(stderr, "%s\n", e.what());
+        write_failed = true;
+        continue;
+      }
+
+      num_positions += game.size();
+      if (++num_games_written % 100 == 0)
+      {
+        std::printf("%lu games, %lu positions\n", num_games_written, num_positions);
+        std::fflush(stdout);
+      }
+    }
+  });
+
+  std::atomic<std::uint64_t> next_game{0};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < num_threads; t++)
+  {
+    workers.emplace_back([&]
+    {
+      std::uint64_t game_index;
+      while (!write_failed && (game_index = next_game.fetch_add(1)) < num_games)
+      {
+        queue.push(play_game(game_index, limits));
+      }
+    });
+  }
+
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  queue.close();
+  writer.join();
+
+  try
+  {
+    out->close();
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::fprintf(stderr, "%s\n", e.what());
+    write_failed = true;
+  }
+
+  if (write_failed)
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::printf("Wrote %lu positions from %lu games\n", num_positions, num_games_written);
+
+  return EXIT_SUCCESS;
+}
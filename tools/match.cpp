@@ -0,0 +1,890 @@
+#include "search/mcts.h"
+#include "search/search.h"
+#include "search/time_manager.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Play a match between two engines and test whether the first is stronger.
+// Usage: match <engine A> <engine B> [games] [limit] [concurrency] [openings file]
+//
+// An engine is either "internal" with optional parameter overrides, e.g.
+// "internal:futility_margin=120,null_move_reduction=2", or the command line of an external engine
+// which speaks the text protocol, e.g. "./build/uci/los_alamos_uci". "mcts" is the Monte Carlo
+// tree search backend, on one thread unless overridden, e.g. "mcts:threads=4,exploration=1.2". Its
+// node limit counts playouts, so compare the backends with a time limit.
+// The limit is one of "nodes=N" (the default is nodes=20000), "movetime=MS" or "depth=N" per
+// move, or a clock of "tc=MS+MS" per game. A player whose clock runs out loses.
+// Each opening is played twice with the colours reversed. Openings are read one per line from the
+// file if given, otherwise they are random positions which a short search considers balanced.
+// Games run concurrently, each on its own core, until the sequential probability ratio test accepts
+// one of its hypotheses or the games run out.
+
+namespace
+{
+
+// SPRT hypotheses about engine A's Elo advantage, with the error rates of the test.
+constexpr double sprt_elo0 = 0.0;
+constexpr double sprt_elo1 = 5.0;
+constexpr double sprt_alpha = 0.05;
+constexpr double sprt_beta = 0.05;
+
+constexpr int random_opening_plies = 6;
+constexpr int balanced_opening_margin = 50;
+constexpr int max_game_plies = 300;
+constexpr int max_halfmove_clock = 100;
+
+struct Limit
+{
+  enum { NODES, MOVETIME, DEPTH, CLOCK } type = NODES;
+  std::uint64_t value = 20000;
+  std::uint64_t increment = 0; // Only for clocks.
+};
+
+Limit parse_limit(const std::string& str)
+{
+  const auto equals = str.find('=');
+  if (equals == std::string::npos)
+  {
+    throw std::invalid_argument("Malformed limit: " + str);
+  }
+
+  const auto name = str.substr(0, equals);
+
+  Limit limit;
+  limit.value = std::strtoull(str.c_str() + equals + 1, nullptr, 10);
+  if (name == "nodes") limit.type = Limit::NODES;
+  else if (name == "movetime") limit.type = Limit::MOVETIME;
+  else if (name == "depth") limit.type = Limit::DEPTH;
+  else if (name == "tc")
+  {
+    limit.type = Limit::CLOCK;
+    const auto plus = str.find('+', equals);
+    limit.increment = plus != std::string::npos ? std::strtoull(str.c_str() + plus + 1, nullptr, 10) : 0;
+  }
+  else throw std::invalid_argument("Unknown limit: " + name);
+
+  return limit;
+}
+
+// A game in progress. External engines are sent the moves from the opening, so that they know the
+// position's history.
+struct Game
+{
+  std::string opening;
+  la::Board board;
+  std::vector<std::string> moves;
+  std::array<std::chrono::milliseconds, 2> clocks; // Indexed by colour.
+};
+
+std::string to_lower(std::string str)
+{
+  std::transform(str.begin(), str.end(), str.begin(), [] (unsigned char c)
+  {
+    return static_cast<char>(std::tolower(c));
+  });
+
+  return str;
+}
+
+class Player
+{
+public:
+  virtual ~Player() = default;
+
+  virtual void new_game() = 0;
+  virtual la::Move get_move(const Game&, const Limit&) = 0;
+};
+
+// Runs jobs one at a time on a persistent thread.
+// Each internal player searches on its own thread, so it keeps its own transposition table.
+class JobThread
+{
+public:
+  JobThread()
+    : thread_([this] { thread_func(); })
+  {
+  }
+
+  ~JobThread()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  // Blocks until the job has run.
+  void run(std::function<void()> job)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = std::move(job);
+    cv_.notify_all();
+    cv_.wait(lock, [this] { return !job_; });
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::function<void()> job_;
+  bool quit_ = false;
+
+  // Declared last so everything it uses is constructed before it starts.
+  std::thread thread_;
+
+  void thread_func()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      cv_.wait(lock, [this] { return job_ || quit_; });
+      if (quit_)
+      {
+        return;
+      }
+
+      job_();
+      job_ = nullptr;
+      cv_.notify_all();
+    }
+  }
+};
+
+la::SearchLimits to_search_limits(const Game& game, const Limit& limit)
+{
+  la::SearchLimits limits;
+  switch (limit.type)
+  {
+    case Limit::NODES: limits.nodes = limit.value; break;
+    case Limit::MOVETIME: limits.time = std::chrono::milliseconds(limit.value); break;
+    case Limit::DEPTH: limits.depth = static_cast<int>(limit.value); break;
+    case Limit::CLOCK:
+    {
+      la::TimeControl tc;
+      tc.remaining = game.clocks[static_cast<int>(game.board.player_to_move())];
+      tc.increment = std::chrono::milliseconds(limit.increment);
+
+      const auto allocation = la::allocate_time(tc);
+      limits.time = allocation.hard;
+      limits.soft_time = allocation.soft;
+      break;
+    }
+  }
+
+  return limits;
+}
+
+class InternalPlayer : public Player
+{
+public:
+  explicit InternalPlayer(const la::SearchParams& params)
+    : params_(params)
+  {
+  }
+
+  void new_game() override {}
+
+  la::Move get_move(const Game& game, const Limit& limit) override
+  {
+    const auto limits = to_search_limits(game, limit);
+
+    la::Move move = 0;
+    thread_.run([&]
+    {
+      auto board = game.board;
+      move = la::search(board, limits, [] (const la::SearchData&) {}, params_);
+    });
+
+    return move;
+  }
+
+private:
+  la::SearchParams params_;
+  JobThread thread_;
+};
+
+// The Monte Carlo tree search backend. Its thread keeps the tree's memory between moves.
+class MctsPlayer : public Player
+{
+public:
+  explicit MctsPlayer(const la::mcts::Params& params)
+    : params_(params)
+  {
+  }
+
+  void new_game() override {}
+
+  la::Move get_move(const Game& game, const Limit& limit) override
+  {
+    const auto limits = to_search_limits(game, limit);
+
+    la::Move move = 0;
+    thread_.run([&]
+    {
+      auto board = game.board;
+      move = la::mcts::search(board, limits, [] (const la::SearchData&) {}, params_);
+    });
+
+    return move;
+  }
+
+private:
+  la::mcts::Params params_;
+  JobThread thread_;
+};
+
+// Overrides the default parameters with a comma separated list of name=value pairs.
+la::SearchParams parse_params(const std::string& overrides)
+{
+  static const std::pair<const char*, int la::SearchParams::*> fields[] =
+  {
+    { "threads", &la::SearchParams::threads },
+    { "iid_min_depth", &la::SearchParams::iid_min_depth },
+    { "iid_reduction", &la::SearchParams::iid_reduction },
+    { "singular_min_depth", &la::SearchParams::singular_min_depth },
+    { "singular_margin_per_ply", &la::SearchParams::singular_margin_per_ply },
+    { "null_move_min_depth", &la::SearchParams::null_move_min_depth },
+    { "null_move_reduction", &la::SearchParams::null_move_reduction },
+    { "null_move_depth_divisor", &la::SearchParams::null_move_depth_divisor },
+    { "null_move_verification_depth", &la::SearchParams::null_move_verification_depth },
+    { "reverse_futility_max_depth", &la::SearchParams::reverse_futility_max_depth },
+    { "reverse_futility_margin", &la::SearchParams::reverse_futility_margin },
+    { "futility_max_depth", &la::SearchParams::futility_max_depth },
+    { "futility_margin", &la::SearchParams::futility_margin },
+    { "late_move_max_depth", &la::SearchParams::late_move_max_depth },
+    { "late_move_base", &la::SearchParams::late_move_base },
+    { "probcut_min_depth", &la::SearchParams::probcut_min_depth },
+    { "probcut_reduction", &la::SearchParams::probcut_reduction },
+    { "probcut_margin", &la::SearchParams::probcut_margin },
+    { "mate_solver_min_score", &la::SearchParams::mate_solver_min_score },
+    { "mate_solver_max_plies", &la::SearchParams::mate_solver_max_plies }
+  };
+
+  la::SearchParams params;
+
+  std::istringstream ss(overrides);
+  std::string item;
+  while (std::getline(ss, item, ','))
+  {
+    const auto equals = item.find('=');
+    const auto name = item.substr(0, equals);
+    const auto value = equals != std::string::npos ? item.substr(equals + 1) : "";
+    if (value.empty())
+    {
+      throw std::invalid_argument("Malformed parameter: " + item);
+    }
+
+    if (name == "hash_size_mb")
+    {
+      params.hash_size_mb = std::strtoull(value.c_str(), nullptr, 10);
+      continue;
+    }
+
+    const auto field = std::find_if(std::begin(fields), std::end(fields), [&name] (const auto& f)
+    {
+      return name == f.first;
+    });
+
+    if (field == std::end(fields))
+    {
+      throw std::invalid_argument("Unknown parameter: " + name);
+    }
+
+    params.*(field->second) = std::atoi(value.c_str());
+  }
+
+  return params;
+}
+
+// As parse_params, for the Monte Carlo tree search's parameters. Games already run concurrently,
+// so the search uses one thread unless told otherwise.
+la::mcts::Params parse_mcts_params(const std::string& overrides)
+{
+  la::mcts::Params params;
+  params.threads = 1;
+
+  std::istringstream ss(overrides);
+  std::string item;
+  while (std::getline(ss, item, ','))
+  {
+    const auto equals = item.find('=');
+    const auto name = item.substr(0, equals);
+    const auto value = equals != std::string::npos ? item.substr(equals + 1) : "";
+    if (value.empty())
+    {
+      throw std::invalid_argument("Malformed parameter: " + item);
+    }
+
+    if (name == "threads") params.threads = std::strtoul(value.c_str(), nullptr, 10);
+    else if (name == "max_nodes") params.max_nodes = std::strtoull(value.c_str(), nullptr, 10);
+    else if (name == "exploration") params.exploration = std::strtof(value.c_str(), nullptr);
+    else if (name == "virtual_loss") params.virtual_loss = std::atoi(value.c_str());
+    else if (name == "quiescence_depth") params.quiescence_depth = std::atoi(value.c_str());
+    else if (name == "score_scale") params.score_scale = std::strtof(value.c_str(), nullptr);
+    else throw std::invalid_argument("Unknown parameter: " + name);
+  }
+
+  return params;
+}
+
+// An engine in a child process, driven through pipes to its standard input and output.
+class ExternalPlayer : public Player
+{
+public:
+  explicit ExternalPlayer(const std::string& command)
+  {
+    std::vector<std::string> args;
+    std::istringstream ss(command);
+    std::string arg;
+    while (ss >> arg)
+    {
+      args.push_back(arg);
+    }
+
+    // Only async-signal-safe calls are allowed between fork and exec, so prepare everything first.
+    std::vector<char*> argv;
+    for (auto& a : args)
+    {
+      argv.push_back(a.data());
+    }
+
+    argv.push_back(nullptr);
+
+    // Engines started concurrently by other games mustn't inherit these pipes, so they're closed
+    // on exec from the start.
+    int to_child[2], from_child[2];
+    if (args.empty() || pipe2(to_child, O_CLOEXEC) != 0)
+    {
+      throw std::runtime_error("Failed to start engine: " + command);
+    }
+
+    if (pipe2(from_child, O_CLOEXEC) != 0)
+    {
+      close(to_child[0]);
+      close(to_child[1]);
+      throw std::runtime_error("Failed to start engine: " + command);
+    }
+
+    pid_ = fork();
+    if (pid_ == 0)
+    {
+      dup2(to_child[0], STDIN_FILENO);
+      dup2(from_child[1], STDOUT_FILENO);
+      close(to_child[0]);
+      close(to_child[1]);
+      close(from_child[0]);
+      close(from_child[1]);
+      execvp(argv[0], argv.data());
+      _exit(127);
+    }
+
+    close(to_child[0]);
+    close(from_child[1]);
+
+    if (pid_ < 0)
+    {
+      close(to_child[1]);
+      close(from_child[0]);
+      throw std::runtime_error("Failed to start engine: " + command);
+    }
+
+    in_ = fdopen(to_child[1], "w");
+    out_ = fdopen(from_child[0], "r");
+
+    // The destructor won't run if the engine doesn't start, so clean up here. The child may not be
+    // listening for quit, e.g. if it isn't a UCI engine, so it's killed.
+    try
+    {
+      if (!in_ || !out_)
+      {
+        throw std::runtime_error("Failed to start engine: " + command);
+      }
+
+      send("uci");
+      wait_for("uciok");
+    }
+    catch (...)
+    {
+      if (in_) std::fclose(in_);
+      else close(to_child[1]);
+
+      if (out_) std::fclose(out_);
+      else close(from_child[0]);
+
+      kill(pid_, SIGKILL);
+      waitpid(pid_, nullptr, 0);
+      std::free(line_);
+      throw;
+    }
+  }
+
+  ~ExternalPlayer() override
+  {
+    std::fputs("quit\n", in_);
+    std::fclose(in_);
+    std::fclose(out_);
+    waitpid(pid_, nullptr, 0);
+    std::free(line_);
+  }
+
+  void new_game() override
+  {
+    send("ucinewgame");
+    send("isready");
+    wait_for("readyok");
+  }
+
+  la::Move get_move(const Game& game, const Limit& limit) override
+  {
+    std::string position = "position fen " + game.opening;
+    if (!game.moves.empty())
+    {
+      position += " moves";
+      for (const auto& move : game.moves)
+      {
+        position += " " + move;
+      }
+    }
+
+    send(position);
+
+    switch (limit.type)
+    {
+      case Limit::NODES: send("go nodes " + std::to_string(limit.value)); break;
+      case Limit::MOVETIME: send("go movetime " + std::to_string(limit.value)); break;
+      case Limit::DEPTH: send("go depth " + std::to_string(limit.value)); break;
+      case Limit::CLOCK:
+        send(
+          "go wtime " + std::to_string(game.clocks[0].count()) +
+          " btime " + std::to_string(game.clocks[1].count()) +
+          " winc " + std::to_string(limit.increment) +
+          " binc " + std::to_string(limit.increment));
+        break;
+    }
+
+    const auto reply = wait_for("bestmove");
+    std::istringstream ss(reply);
+    std::string token, move_str;
+    ss >> token >> move_str;
+
+    const auto target = to_lower(move_str);
+    for (const auto move : game.board.get_moves())
+    {
+      if (to_lower(game.board.move_to_string(move)) == target)
+      {
+        return move;
+      }
+    }
+
+    throw std::runtime_error("Engine played an illegal move: " + move_str);
+  }
+
+private:
+  pid_t pid_;
+  FILE* in_;
+  FILE* out_;
+  char* line_ = nullptr;
+  std::size_t line_capacity_ = 0;
+
+  void send(const std::string& command)
+  {
+    std::fprintf(in_, "%s\n", command.c_str());
+    std::fflush(in_);
+  }
+
+  // Returns the first line starting with the given token.
+  std::string wait_for(const char* token)
+  {
+    const auto length = std::strlen(token);
+    while (getline(&line_, &line_capacity_, out_) > 0)
+    {
+      if (std::strncmp(line_, token, length) == 0)
+      {
+        return line_;
+      }
+    }
+
+    throw std::runtime_error("Engine exited unexpectedly");
+  }
+};
+
+std::unique_ptr<Player> make_player(const std::string& spec)
+{
+  if (spec == "internal")
+  {
+    return std::make_unique<InternalPlayer>(la::SearchParams());
+  }
+
+  if (spec.rfind("internal:", 0) == 0)
+  {
+    return std::make_unique<InternalPlayer>(parse_params(spec.substr(9)));
+  }
+
+  if (spec == "mcts" || spec.rfind("mcts:", 0) == 0)
+  {
+    return std::make_unique<MctsPlayer>(parse_mcts_params(spec.size() > 4 ? spec.substr(5) : ""));
+  }
+
+  return std::make_unique<ExternalPlayer>(spec);
+}
+
+std::vector<std::string> load_openings(const char* path)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    throw std::runtime_error("Failed to open " + std::string(path));
+  }
+
+  std::vector<std::string> openings;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (!line.empty() && line[0] != '#')
+    {
+      la::Board board(line); // Reject malformed positions up front.
+      openings.push_back(line);
+    }
+  }
+
+  return openings;
+}
+
+// Random positions near the start which neither side is clearly winning.
+std::vector<std::string> generate_openings(std::size_t num_openings)
+{
+  la::SearchParams params;
+  params.mate_solver_max_plies = 0;
+
+  la::SearchLimits limits;
+  limits.depth = 4;
+
+  std::mt19937_64 rng(0);
+  std::vector<std::string> openings;
+  while (openings.size() < num_openings)
+  {
+    la::Board board;
+    bool ok = true;
+    for (int ply = 0; ply < random_opening_plies && ok; ply++)
+    {
+      const auto moves = board.get_moves();
+      ok = !moves.empty();
+      if (ok)
+      {
+        board.make_move(moves[rng() % moves.size()]);
+      }
+    }
+
+    if (!ok || board.get_moves().empty())
+    {
+      continue;
+    }
+
+    int score = 0;
+    auto search_board = board;
+    la::search(search_board, limits, [&score] (const la::SearchData& data)
+    {
+      score = data.score;
+    }, params);
+
+    if (std::abs(score) <= balanced_opening_margin)
+    {
+      openings.push_back(board.to_fen());
+    }
+  }
+
+  return openings;
+}
+
+// Returns the result from white's perspective: 1, 0 or -1.
+int play_game(const std::string& opening, Player& white, Player& black, const Limit& limit)
+{
+  white.new_game();
+  black.new_game();
+
+  Game game;
+  game.opening = opening;
+  game.board = la::Board(opening);
+  game.clocks.fill(std::chrono::milliseconds(limit.value));
+
+  for (int ply = 0; ply < max_game_plies; ply++)
+  {
+    if (game.board.get_moves().empty())
+    {
+      // Checkmate is a loss for the player to move, otherwise it's a draw.
+      if (!game.board.is_draw() && game.board.in_check())
+      {
+        return game.board.player_to_move() == la::Colour::WHITE ? -1 : 1;
+      }
+
+      return 0;
+    }
+
+    if (game.board.halfmove_clock() >= max_halfmove_clock)
+    {
+      return 0;
+    }
+
+    const bool white_to_move = game.board.player_to_move() == la::Colour::WHITE;
+    auto& player = white_to_move ? white : black;
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto move = player.get_move(game, limit);
+
+    if (limit.type == Limit::CLOCK)
+    {
+      auto& clock = game.clocks[white_to_move ? 0 : 1];
+      clock -= std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+      if (clock.count() < 0)
+      {
+        return white_to_move ? -1 : 1;
+      }
+
+      clock += std::chrono::milliseconds(limit.increment);
+    }
+
+    game.moves.push_back(to_lower(game.board.move_to_string(move)));
+    game.board.make_move(move);
+  }
+
+  return 0;
+}
+
+void pin_to_core(unsigned core)
+{
+#if defined(__linux__)
+  const unsigned num_cores = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(core % num_cores, &cpus);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+  (void)core;
+#endif
+}
+
+// Results from engine A's perspective.
+struct Results
+{
+  std::uint64_t wins = 0;
+  std::uint64_t draws = 0;
+  std::uint64_t losses = 0;
+
+  std::uint64_t games() const { return wins + draws + losses; }
+  double score() const { return (wins + 0.5 * draws) / games(); }
+
+  // The variance of a single game's score.
+  double variance() const
+  {
+    const double s = score();
+    return (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / games();
+  }
+};
+
+double score_to_elo(double score)
+{
+  score = std::clamp(score, 1e-6, 1 - 1e-6);
+  return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+double elo_to_score(double elo)
+{
+  return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+// The log likelihood ratio of the SPRT hypotheses, using the normal approximation to the
+// distribution of game scores.
+double log_likelihood_ratio(const Results& results)
+{
+  const double variance = results.variance();
+  if (results.games() == 0 || variance <= 0)
+  {
+    return 0.0;
+  }
+
+  const double s0 = elo_to_score(sprt_elo0), s1 = elo_to_score(sprt_elo1);
+  return results.games() * (s1 - s0) * (2 * results.score() - s0 - s1) / (2 * variance);
+}
+
+void print_results(const Results& results)
+{
+  const double score = results.score();
+  const double margin = 1.96 * std::sqrt(results.variance() / results.games());
+  const double elo = score_to_elo(score);
+  const double elo_error = (score_to_elo(score + margin) - score_to_elo(score - margin)) / 2;
+
+  std::printf(
+    "Games: %lu W: %lu L: %lu D: %lu Elo: %.1f +/- %.1f LLR: %.2f (%.2f, %.2f)\n",
+    results.games(),
+    results.wins,
+    results.losses,
+    results.draws,
+    elo,
+    elo_error,
+    log_likelihood_ratio(results),
+    std::log(sprt_beta / (1 - sprt_alpha)),
+    std::log((1 - sprt_beta) / sprt_alpha));
+
+  std::fflush(stdout);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::fprintf(
+      stderr,
+      "Usage: %s <engine A> <engine B> [games] [limit] [concurrency] [openings file]\n",
+      argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // A crashed external engine shouldn't take the match down with it.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  const std::uint64_t num_games = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000;
+  const unsigned concurrency = argc > 5
+    ? static_cast<unsigned>(std::atoi(argv[5]))
+    : std::max(1u, std::thread::hardware_concurrency());
+
+  Limit limit;
+  std::vector<std::string> openings;
+  try
+  {
+    if (argc > 4)
+    {
+      limit = parse_limit(argv[4]);
+    }
+
+    // Check the engine specifications before starting any games.
+    make_player(argv[1]);
+    make_player(argv[2]);
+
+    openings = argc > 6 ? load_openings(argv[6]) : generate_openings((num_games + 1) / 2);
+    if (openings.empty())
+    {
+      throw std::runtime_error("No openings");
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::fprintf(stderr, "%s\n", e.what());
+    return EXIT_FAILURE;
+  }
+
+  const double lower_bound = std::log(sprt_beta / (1 - sprt_alpha));
+  const double upper_bound = std::log((1 - sprt_beta) / sprt_alpha);
+
+  std::mutex results_mutex;
+  Results results;
+  std::atomic<bool> finished{false}, failed{false};
+  std::atomic<std::uint64_t> next_game{0};
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < concurrency; t++)
+  {
+    workers.emplace_back([&, t]
+    {
+      // Engine threads and processes started from here inherit the core.
+      pin_to_core(t);
+
+      try
+      {
+        auto a = make_player(argv[1]);
+        auto b = make_player(argv[2]);
+
+        std::uint64_t game_index;
+        while (!finished && (game_index = next_game.fetch_add(1)) < num_games)
+        {
+          // Consecutive games play the same opening with the colours reversed.
+          const auto& opening = openings[(game_index / 2) % openings.size()];
+          const bool a_is_white = game_index % 2 == 0;
+          const int result = a_is_white
+            ? play_game(opening, *a, *b, limit)
+            : -play_game(opening, *b, *a, limit);
+
+          std::lock_guard<std::mutex> lock(results_mutex);
+          if (result > 0) ++results.wins;
+          else if (result < 0) ++results.losses;
+          else ++results.draws;
+
+          print_results(results);
+
+          const double llr = log_likelihood_ratio(results);
+          if (llr <= lower_bound || llr >= upper_bound)
+          {
+            finished = true;
+          }
+        }
+      }
+      catch (const std::exception& e)
+      {
+        std::fprintf(stderr, "%s\n", e.what());
+        failed = true;
+        finished = true;
+      }
+    });
+  }
+
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  if (failed)
+  {
+    return EXIT_FAILURE;
+  }
+
+  const double llr = log_likelihood_ratio(results);
+  if (llr >= upper_bound)
+  {
+    std::printf("H1 accepted: engine A is stronger\n");
+  }
+  else if (llr <= lower_bound)
+  {
+    std::printf("H0 accepted: engine A is not stronger\n");
+  }
+  else
+  {
+    std::printf("Inconclusive\n");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+#include "engine/board.h"
+#include "engine/tt.h"
+#include "tt_entry.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Time the board's hot paths over a fixed corpus of positions.
+// Usage: microbench [--json] [min ms per case]
+// Each case runs in batches over the whole corpus until the minimum time has passed, and reports
+// the mean time per operation.
+
+namespace
+{
+
+const char* const corpus[] =
+{
+  "rnqknr/pppppp/6/6/PPPPPP/RNQKNR w",
+  "rnqknr/p1pppp/1p4/PPPP2/2Q2P/RN1KNR b",
+  "rnqk1r/1pp1pp/p5/P1pP2/1PPNPP/R2KNR w",
+  "r1qknr/1pn2p/1pp1p1/3P2/PQ1PPP/1R1K1R b",
+  "1q1n1r/rp3k/p2ppn/PP1P1N/R1PK2/1NQ2R w",
+  "rnk2r/pp1p1p/1QN3/1PN3/PKPq2/1R3R b",
+  "3k1r/p3p1/nr3p/QPq2P/3pP1/2RK1R w",
+  "r3nr/2pkqR/p1pp2/N2P2/PP4/R2K2 b",
+  "2rk2/2N3/5n/2Q1Pr/PPP2P/RR2K1 w",
+  "4n1/r1pk1p/n5/P5/N1K3/4Nn b",
+  "2k1nr/p1p3/5p/N1PP2/1K4/6 b",
+  "3k2/6/6/2Q3/6/3K2 w"
+};
+
+// Results are accumulated here so the compiler can't discard the work being timed.
+volatile std::uint64_t sink;
+
+struct Result
+{
+  std::string name;
+  std::uint64_t operations;
+  double ns_per_operation;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// `batch` runs the case once over the corpus and returns the number of operations performed.
+Result run(const std::string& name, std::chrono::milliseconds min_time, std::function<std::uint64_t()> batch)
+{
+  // Warm up.
+  batch();
+
+  std::uint64_t operations = 0;
+  const auto start = Clock::now();
+  auto elapsed = Clock::duration::zero();
+  while (elapsed < min_time)
+  {
+    operations += batch();
+    elapsed = Clock::now() - start;
+  }
+
+  const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  return { name, operations, ns / operations };
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  bool json = false;
+  std::chrono::milliseconds min_time{500};
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--json") == 0) json = true;
+    else min_time = std::chrono::milliseconds(std::atoi(argv[i]));
+  }
+
+  std::vector<la::Board> boards;
+  for (const auto fen : corpus)
+  {
+    boards.emplace_back(fen);
+  }
+
+  std::vector<Result> results;
+
+  for (const auto& [name, type] : {
+    std::make_pair("get_moves/ALL", la::MoveGenType::ALL),
+    std::make_pair("get_moves/QUIET", la::MoveGenType::QUIET),
+    std::make_pair("get_moves/DYNAMIC", la::MoveGenType::DYNAMIC) })
+  {
+    const auto move_gen_type = type;
+    results.push_back(run(name, min_time, [&boards, move_gen_type]
+    {
+      std::uint64_t total = 0;
+      for (const auto& board : boards)
+      {
+        total += board.get_moves(move_gen_type).size();
+      }
+
+      sink = sink + total;
+      return static_cast<std::uint64_t>(boards.size());
+    }));
+  }
+
+  // Make and undo every legal move in each position.
+  std::vector<std::vector<la::Move>> moves;
+  for (const auto& board : boards)
+  {
+    moves.push_back(board.get_moves());
+  }
+
+  results.push_back(run("make_undo_move", min_time, [&boards, &moves]
+  {
+    std::uint64_t operations = 0, total = 0;
+    for (std::size_t i = 0; i < boards.size(); i++)
+    {
+      for (const auto move : moves[i])
+      {
+        boards[i].make_move(move);
+        total += boards[i].hash();
+        boards[i].undo_move(move);
+      }
+
+      operations += moves[i].size();
+    }
+
+    sink = sink + total;
+    return operations;
+  }));
+
+  results.push_back(run("in_check", min_time, [&boards]
+  {
+    std::uint64_t total = 0;
+    for (const auto& board : boards)
+    {
+      total += board.in_check();
+    }
+
+    sink = sink + total;
+    return static_cast<std::uint64_t>(boards.size());
+  }));
+
+  // is_draw walks the position's history, so give each position one as long as a search's line
+  // from the root of a game might be.
+  constexpr int history_plies = 40;
+  std::mt19937_64 rng(1);
+  std::vector<la::Board> history_boards = boards;
+  for (auto& board : history_boards)
+  {
+    for (int ply = 0; ply < history_plies; ply++)
+    {
+      const auto history_moves = board.get_moves();
+      if (history_moves.empty())
+      {
+        break;
+      }
+
+      board.make_move(history_moves[rng() % history_moves.size()]);
+    }
+  }
+
+  results.push_back(run("is_draw", min_time, [&history_boards]
+  {
+    std::uint64_t total = 0;
+    for (const auto& board : history_boards)
+    {
+      total += board.is_draw();
+    }
+
+    sink = sink + total;
+    return static_cast<std::uint64_t>(history_boards.size());
+  }));
+
+  results.push_back(run("hash", min_time, [&boards]
+  {
+    std::uint64_t total = 0;
+    for (const auto& board : boards)
+    {
+      total ^= board.hash();
+    }
+
+    sink = sink + total;
+    return static_cast<std::uint64_t>(boards.size());
+  }));
+
+  // Probe a table much larger than the cache with the hashes of positions from random playouts
+  // of the corpus. There are enough of them that almost every probe misses the cache, as probes
+  // in a deep search do.
+  constexpr std::size_t num_probe_hashes = 1 << 20;
+  constexpr int max_playout_plies = 100;
+  std::vector<std::uint64_t> hashes;
+  hashes.reserve(num_probe_hashes);
+  for (std::size_t i = 0; hashes.size() < num_probe_hashes; i = (i + 1) % boards.size())
+  {
+    la::Board board = boards[i];
+    for (int ply = 0; ply < max_playout_plies && hashes.size() < num_probe_hashes; ply++)
+    {
+      const auto playout_moves = board.get_moves();
+      if (playout_moves.empty())
+      {
+        break;
+      }
+
+      board.make_move(playout_moves[rng() % playout_moves.size()]);
+      hashes.push_back(board.hash());
+    }
+  }
+
+  // The search's table: a 64MB table of buckets, probed and then stored to on a miss as minimax
+  // does.
+  using la::detail::Entry;
+  auto table = std::make_unique<la::TT<Entry>>(1 << 20);
+  results.push_back(run("tt_probe", min_time, [&table, &hashes]
+  {
+    std::uint64_t total = 0;
+    for (const auto hash : hashes)
+    {
+      Entry* entry = table->slot(hash);
+      if (const auto entry_data = entry->load(hash))
+      {
+        total += entry_data->depth;
+      }
+      else
+      {
+        entry->store(hash, { 1, 0, 0, 1 });
+      }
+    }
+
+    sink = sink + total;
+    return static_cast<std::uint64_t>(hashes.size());
+  }));
+
+  if (json)
+  {
+    std::printf("{\n  \"positions\": %zu,\n  \"benchmarks\": [\n", boards.size());
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+      std::printf(
+        "    { \"name\": \"%s\", \"operations\": %lu, \"ns_per_operation\": %.2f }%s\n",
+        results[i].name.c_str(),
+        results[i].operations,
+        results[i].ns_per_operation,
+        i + 1 < results.size() ? "," : "");
+    }
+
+    std::printf("  ]\n}\n");
+  }
+  else
+  {
+    for (const auto& result : results)
+    {
+      std::printf("%-20s %14lu ops %10.2f ns/op\n",
+        result.name.c_str(), result.operations, result.ns_per_operation);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
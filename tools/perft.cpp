@@ -16,9 +16,12 @@ struct Entry
   std::size_t num_child_nodes;
 };
 
-using Table = la::TT<Entry, 65536>;
+using Table = la::TT<Entry>;
 #else
-struct Table {};
+struct Table
+{
+  explicit Table(std::size_t) {}
+};
 #endif
 
 std::uint64_t perft(la::Board& board, int depth, Table& tt)
@@ -64,7 +67,7 @@ int main()
 {
   std::cout << "Calculating perft\n";
 
-  Table tt;
+  Table tt(65536);
 
   using Clock = std::chrono::steady_clock;
   const auto start = Clock::now();
@@ -1,21 +1,210 @@
+#include "engine/book.h"
+#include "engine/instrument.h"
+#include "engine/nnue.h"
+#include "engine/tablebase.h"
+#include "search/pool.h"
 #include "search/search.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
-int main()
+// Usage: search_test [tablebase dir] [network file] [book file]
+//        search_test bench [depth]
+//        search_test batch <positions file> [depth] [hash MB per thread]
+
+namespace
+{
+
+// Positions for the bench: the start, openings, middlegames and endgames.
+const char* const bench_positions[] =
+{
+  "rnqknr/pppppp/6/6/PPPPPP/RNQKNR w",
+  "rnqknr/p1pppp/1p4/PPPP2/2Q2P/RN1KNR b",
+  "rnqk1r/1pp1pp/p5/P1pP2/1PPNPP/R2KNR w",
+  "r1qknr/1pn2p/1pp1p1/3P2/PQ1PPP/1R1K1R b",
+  "1q1n1r/rp3k/p2ppn/PP1P1N/R1PK2/1NQ2R w",
+  "rnk2r/pp1p1p/1QN3/1PN3/PKPq2/1R3R b",
+  "3k1r/p3p1/nr3p/QPq2P/3pP1/2RK1R w",
+  "r2q1r/p1pk1p/1p1p1n/PPP2P/1Q1P1K/RN3R b",
+  "2rk2/2N3/5n/2Q1Pr/PPP2P/RR2K1 w",
+  "4n1/r1pk1p/n5/P5/N1K3/4Nn b",
+  "2k1nr/p1p3/5p/N1PP2/1K4/6 b",
+  "3k2/6/6/2Q3/6/3K2 w"
+};
+
+// Search each bench position to a fixed depth. The total node count is a signature of the search's
+// behaviour: changes which should only affect speed must leave it unchanged.
+int bench(int depth)
+{
+  la::SearchLimits limits;
+  limits.depth = depth;
+
+  // The mate solver runs on its own thread, so it would make the node counts timing dependent.
+  la::SearchParams params;
+  params.mate_solver_max_plies = 0;
+
+  std::uint64_t total_nodes = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto fen : bench_positions)
+  {
+    la::Board board(fen);
+    std::uint64_t nodes = 0;
+    const auto move = la::search(board, limits, [&nodes] (const la::SearchData& data)
+    {
+      nodes += data.nodes_searched;
+    }, params);
+
+    std::printf("%-40s %6s %13lu\n", fen, board.move_to_string(move).c_str(), nodes);
+    total_nodes += nodes;
+  }
+
+  const auto time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start);
+
+  std::printf("Nodes: %lu\n", total_nodes);
+  std::printf("Time: %ldms\n", time_taken.count());
+  std::printf("NPS: %lu\n", total_nodes * 1000 / std::max<std::uint64_t>(1, time_taken.count()));
+
+#if defined(LA_INSTRUMENT)
+  std::printf("%s", la::instrument::to_string(la::instrument::totals()).c_str());
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+// Search each position in the file, one per line, on a thread per core.
+int batch(const char* path, int depth, int hash_size_mb)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    std::fprintf(stderr, "Failed to open %s\n", path);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> fens;
+  std::vector<la::Board> boards;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (line.empty()) continue;
+
+    try
+    {
+      boards.emplace_back(line);
+      fens.push_back(line);
+    }
+    catch (const std::invalid_argument& e)
+    {
+      std::fprintf(stderr, "Skipping %s: %s\n", line.c_str(), e.what());
+    }
+  }
+
+  la::SearchLimits limits;
+  limits.depth = depth;
+
+  // Every thread in the pool keeps a table of this size.
+  la::SearchParams params;
+  params.hash_size_mb = hash_size_mb;
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto results = la::search_many(boards, limits, params);
+  const auto time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start);
+
+  std::uint64_t total_nodes = 0;
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    const auto& result = results[i];
+    std::printf("%-40s %6s %7d %13lu\n",
+      fens[i].c_str(),
+      result.best_move ? boards[i].move_to_string(result.best_move).c_str() : "none",
+      result.data.score,
+      result.data.total_nodes);
+
+    total_nodes += result.data.total_nodes;
+  }
+
+  std::printf("Positions: %zu\n", results.size());
+  std::printf("Nodes: %lu\n", total_nodes);
+  std::printf("Time: %ldms\n", time_taken.count());
+  std::printf("NPS: %lu\n", total_nodes * 1000 / std::max<std::uint64_t>(1, time_taken.count()));
+
+  return EXIT_SUCCESS;
+}
+
+}
+
+int main(int argc, char** argv)
 {
+  if (argc > 1 && std::strcmp(argv[1], "bench") == 0)
+  {
+    return bench(argc > 2 ? std::atoi(argv[2]) : 7);
+  }
+
+  if (argc > 2 && std::strcmp(argv[1], "batch") == 0)
+  {
+    return batch(argv[2], argc > 3 ? std::atoi(argv[3]) : 7, argc > 4 ? std::atoi(argv[4]) : 16);
+  }
+
+  // The search works without tablebases or a book, so failing to load them isn't fatal.
+  if (argc > 1)
+  {
+    try
+    {
+      std::printf("Loaded %d tablebases\n", la::tablebase::init(argv[1]));
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::fprintf(stderr, "Continuing without tablebases: %s\n", e.what());
+    }
+  }
+
+  if (argc > 2)
+  {
+    la::nnue::load(argv[2]);
+  }
+
+  if (argc > 3)
+  {
+    try
+    {
+      std::printf("Loaded %zu book entries\n", la::book::init(argv[3]));
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::fprintf(stderr, "Continuing without a book: %s\n", e.what());
+    }
+  }
+
   la::Board board;
 
   const auto callback = [&board] (const la::SearchData& data)
   {
     std::printf(
-      "%6d %6s %7d %13ld %10ldms\n",
+      "%3d/%-3d %6s %7d %13ld %10ldms %9lu nps %13lu qnodes %5.1f%% tt hits %4d hashfull "
+      "%5.1f%% pawn hits %5.1f%% first move cut-offs %5.2f ebf\n",
       data.depth,
+      data.seldepth,
       board.move_to_string(data.best_move).c_str(),
       data.score,
-      data.nodes_searched,
-      data.time_taken.count());
+      data.total_nodes,
+      data.time_taken.count(),
+      data.nodes_per_second,
+      data.quiescence_nodes,
+      100.0 * data.tt_hit_rate,
+      data.hashfull,
+      100.0 * data.pawn_hit_rate,
+      100.0 * data.first_move_cutoff_rate,
+      data.branching_factor);
 
     std::fflush(stdout);
   };
@@ -24,5 +213,9 @@ int main()
 
   la::search(board, search_time, callback);
 
+#if defined(LA_INSTRUMENT)
+  std::printf("%s", la::instrument::to_string(la::instrument::totals()).c_str());
+#endif
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,413 @@
+#include "engine/board.h"
+#include "engine/tablebase.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Generate endgame tablebases by retrograde analysis.
+// Usage: tbgen <output directory> <material>...
+// where each material is named like "KQvK" or "KRvKN". Tables for any material reachable by
+// captures or promotions are generated (and written) first.
+
+namespace
+{
+
+using la::tablebase::Value;
+
+// Marks positions which haven't been solved yet.
+constexpr Value unresolved = 0xFE;
+
+// Marks a position with a move out of the table which doesn't lose.
+constexpr std::uint8_t exit_not_lost = 0xFF;
+
+// Each thread analyses a contiguous chunk of the table.
+// Moves which stay in the table are stored as edges, and moves which leave it (captures and
+// promotions) are summarised by the shortest win and longest loss they lead to.
+struct Chunk
+{
+  std::size_t begin, end;
+  std::vector<std::uint32_t> offsets;
+  std::vector<std::uint32_t> edges;
+  int max_exit_plies = 0;
+};
+
+struct Table
+{
+  std::vector<la::Piece> pieces;
+  std::vector<Value> values;
+};
+
+std::map<la::material::Key, Table> tables;
+std::string output_directory;
+unsigned num_threads;
+
+template <typename Func>
+void parallel_for(std::vector<Chunk>& chunks, Func func)
+{
+  std::vector<std::thread> threads;
+  for (auto& chunk : chunks)
+  {
+    threads.emplace_back([&func, &chunk] { func(chunk); });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+}
+
+// Set up the position with the given index, or return false if it's not a legal placement.
+bool index_to_fen(const std::vector<la::Piece>& pieces, std::size_t idx, std::string& fen)
+{
+  static constexpr int num_squares = la::board_side * la::board_side;
+  static constexpr const char* piece_chars = " PPNRQK";
+
+  std::array<char, num_squares> squares;
+  squares.fill(0);
+
+  const auto player_to_move = static_cast<la::Colour>(idx % 2);
+  idx /= 2;
+
+  for (const auto& piece : pieces)
+  {
+    const int loc = idx % num_squares;
+    idx /= num_squares;
+
+    if (squares[loc]) return false;
+
+    // Pawns can't stand on either back rank.
+    const int row = loc / la::board_side;
+    if ((piece.type == la::PieceType::PAWN_WHITE || piece.type == la::PieceType::PAWN_BLACK) &&
+        (row == 0 || row == la::board_side - 1))
+    {
+      return false;
+    }
+
+    const char c = piece_chars[static_cast<int>(piece.type)];
+    squares[loc] = piece.colour == la::Colour::WHITE ? c : c - 'A' + 'a';
+  }
+
+  fen.clear();
+  for (int r = la::board_side - 1; r >= 0; r--)
+  {
+    int num_empty = 0;
+    for (int c = 0; c < la::board_side; c++)
+    {
+      const char sq = squares[r * la::board_side + c];
+      if (!sq)
+      {
+        ++num_empty;
+        continue;
+      }
+
+      if (num_empty > 0) fen += static_cast<char>('0' + num_empty);
+      num_empty = 0;
+      fen += sq;
+    }
+
+    if (num_empty > 0) fen += static_cast<char>('0' + num_empty);
+    if (r > 0) fen += '/';
+  }
+
+  fen += player_to_move == la::Colour::WHITE ? " w" : " b";
+  return true;
+}
+
+// Find the value of every position in the chunk which has no moves, and record the moves of the
+// others for the retrograde passes.
+void analyse_moves(
+  la::material::Key key,
+  const std::vector<la::Piece>& pieces,
+  std::vector<Value>& values,
+  std::vector<std::uint8_t>& exit_win,
+  std::vector<std::uint8_t>& exit_loss,
+  Chunk& chunk)
+{
+  std::string fen;
+  chunk.offsets.push_back(0);
+  for (std::size_t idx = chunk.begin; idx < chunk.end; idx++)
+  {
+    if (!index_to_fen(pieces, idx, fen))
+    {
+      values[idx] = la::tablebase::illegal;
+      chunk.offsets.push_back(chunk.edges.size());
+      continue;
+    }
+
+    la::Board board(fen);
+
+    // The player who has just moved can't be in check.
+    board.make_null_move();
+    const bool illegal = board.in_check();
+    board.undo_null_move();
+
+    if (illegal)
+    {
+      values[idx] = la::tablebase::illegal;
+      chunk.offsets.push_back(chunk.edges.size());
+      continue;
+    }
+
+    const auto moves = board.get_moves();
+    if (moves.empty())
+    {
+      values[idx] = board.in_check() ? la::tablebase::loss_in(0) : la::tablebase::draw;
+      chunk.offsets.push_back(chunk.edges.size());
+      continue;
+    }
+
+    for (const auto move : moves)
+    {
+      board.make_move(move);
+
+      const auto child_key = board.material_key();
+      if (child_key == key)
+      {
+        chunk.edges.push_back(la::tablebase::index(board, pieces));
+      }
+      else
+      {
+        const Table& child_table = tables.at(child_key);
+        const Value child =
+          child_table.values[la::tablebase::index(board, child_table.pieces)];
+
+        const int plies = la::tablebase::plies_to_mate(child) + 1;
+        if (la::tablebase::is_loss(child))
+        {
+          if (exit_win[idx] == 0 || plies < exit_win[idx]) exit_win[idx] = plies;
+          exit_loss[idx] = exit_not_lost;
+          chunk.max_exit_plies = std::max(chunk.max_exit_plies, plies);
+        }
+        else if (la::tablebase::is_win(child))
+        {
+          if (exit_loss[idx] != exit_not_lost) exit_loss[idx] = std::max<int>(exit_loss[idx], plies);
+          chunk.max_exit_plies = std::max(chunk.max_exit_plies, plies);
+        }
+        else
+        {
+          exit_loss[idx] = exit_not_lost;
+        }
+      }
+
+      board.undo_move(move);
+    }
+
+    values[idx] = unresolved;
+    chunk.offsets.push_back(chunk.edges.size());
+  }
+}
+
+// Solve the positions which are won or lost in exactly `plies` plies, given that every position
+// won or lost in fewer plies has already been solved.
+std::vector<std::pair<std::size_t, Value>> solve_pass(
+  int plies,
+  const std::vector<Value>& values,
+  const std::vector<std::uint8_t>& exit_win,
+  const std::vector<std::uint8_t>& exit_loss,
+  const Chunk& chunk)
+{
+  std::vector<std::pair<std::size_t, Value>> solved;
+
+  const Value winning_child = la::tablebase::loss_in(plies - 1);
+  for (std::size_t idx = chunk.begin; idx < chunk.end; idx++)
+  {
+    if (values[idx] != unresolved) continue;
+
+    // Won if any move leads to a loss for the opponent, lost if every move leads to a win.
+    bool won = exit_win[idx] == plies;
+    bool lost = exit_loss[idx] != exit_not_lost;
+    int longest_loss = exit_loss[idx];
+
+    const std::size_t i = idx - chunk.begin;
+    for (std::size_t e = chunk.offsets[i]; e < chunk.offsets[i + 1]; e++)
+    {
+      const Value child = values[chunk.edges[e]];
+      if (child == winning_child)
+      {
+        won = true;
+        break;
+      }
+
+      if (la::tablebase::is_win(child))
+      {
+        longest_loss = std::max(longest_loss, la::tablebase::plies_to_mate(child) + 1);
+      }
+      else
+      {
+        lost = false;
+      }
+    }
+
+    if (won)
+    {
+      solved.emplace_back(idx, la::tablebase::win_in(plies));
+    }
+    else if (lost && longest_loss == plies)
+    {
+      solved.emplace_back(idx, la::tablebase::loss_in(plies));
+    }
+  }
+
+  return solved;
+}
+
+void write_table(la::material::Key key, const std::vector<Value>& values)
+{
+  const std::string path =
+    output_directory + "/" + la::material::to_string(key) + la::tablebase::file_extension;
+
+  la::tablebase::FileHeader header = {};
+  std::copy(
+    std::begin(la::tablebase::file_magic), std::end(la::tablebase::file_magic), header.magic);
+  header.version = la::tablebase::file_version;
+  header.material_key = key;
+  header.num_entries = values.size();
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(values.data()), values.size());
+
+  if (!file)
+  {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+void generate(la::material::Key key)
+{
+  if (tables.count(key)) return;
+
+  const auto pieces = la::tablebase::pieces(key);
+
+  // Captures and promotions lead into smaller tables, which must be solved first.
+  for (const auto& piece : pieces)
+  {
+    if (piece.type == la::PieceType::KING) continue;
+
+    const auto piece_key = la::material::piece_key(piece.colour, piece.type);
+    generate(key - piece_key);
+
+    if (piece.type == la::PieceType::PAWN_WHITE || piece.type == la::PieceType::PAWN_BLACK)
+    {
+      for (const auto promo : { la::PieceType::KNIGHT, la::PieceType::ROOK, la::PieceType::QUEEN })
+      {
+        generate(key - piece_key + la::material::piece_key(piece.colour, promo));
+      }
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  const std::size_t size = la::tablebase::table_size(pieces);
+  std::vector<Value> values(size);
+  std::vector<std::uint8_t> exit_win(size, 0), exit_loss(size, 0);
+
+  std::vector<Chunk> chunks(num_threads);
+  for (unsigned t = 0; t < num_threads; t++)
+  {
+    chunks[t].begin = size * t / num_threads;
+    chunks[t].end = size * (t + 1) / num_threads;
+  }
+
+  parallel_for(chunks, [&] (Chunk& chunk)
+  {
+    analyse_moves(key, pieces, values, exit_win, exit_loss, chunk);
+  });
+
+  int max_exit_plies = 0;
+  for (const auto& chunk : chunks)
+  {
+    max_exit_plies = std::max(max_exit_plies, chunk.max_exit_plies);
+  }
+
+  // Each pass only reads values from earlier passes, so the threads collect their results and they
+  // are applied once every thread has finished.
+  std::vector<std::vector<std::pair<std::size_t, Value>>> solved(num_threads);
+  for (int plies = 1; plies <= la::tablebase::max_plies; plies++)
+  {
+    parallel_for(chunks, [&] (Chunk& chunk)
+    {
+      const std::size_t t = &chunk - chunks.data();
+      solved[t] = solve_pass(plies, values, exit_win, exit_loss, chunk);
+    });
+
+    bool changed = false;
+    for (const auto& thread_solved : solved)
+    {
+      for (const auto& [idx, value] : thread_solved)
+      {
+        values[idx] = value;
+        changed = true;
+      }
+    }
+
+    if (!changed && plies > max_exit_plies) break;
+  }
+
+  // Anything which can't be forced either way is a draw.
+  std::size_t num_wins = 0, num_losses = 0, num_draws = 0;
+  int longest_mate = 0;
+  for (auto& value : values)
+  {
+    if (value == unresolved) value = la::tablebase::draw;
+
+    if (la::tablebase::is_win(value)) ++num_wins;
+    else if (la::tablebase::is_loss(value)) ++num_losses;
+    else if (value == la::tablebase::draw) ++num_draws;
+
+    if (value != la::tablebase::illegal)
+    {
+      longest_mate = std::max(longest_mate, la::tablebase::plies_to_mate(value));
+    }
+  }
+
+  write_table(key, values);
+
+  const auto time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start);
+
+  std::printf(
+    "%-8s %10zu wins %10zu draws %10zu losses, longest mate %3d plies, %8ldms\n",
+    la::material::to_string(key).c_str(),
+    num_wins,
+    num_draws,
+    num_losses,
+    longest_mate,
+    time_taken.count());
+
+  std::fflush(stdout);
+
+  tables[key] = { pieces, std::move(values) };
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "Usage: %s <output directory> <material>...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  output_directory = argv[1];
+  num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 2; i < argc; i++)
+  {
+    generate(la::material::from_string(argv[i]));
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "engine/packed_position.h"
+
+#include <cstdint>
+
+// A position from a self-play game, as written by datagen and read by tune.
+struct TrainingRecord
+{
+  static constexpr std::uint32_t record_type = 2;
+
+  la::PackedPosition position;
+  std::int16_t score; // The search score from white's perspective.
+  std::int8_t result; // 1 for a white win, 0 for a draw, -1 for a black win.
+  std::uint8_t padding;
+};
+
+static_assert(sizeof(TrainingRecord) == 24);
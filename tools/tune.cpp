@@ -0,0 +1,431 @@
+#include "engine/board.h"
+#include "engine/records.h"
+#include "training_data.h"
+
+#include "eval.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fit the evaluation tables in eval.h to game results by minimising the error between the
+// results and a sigmoid of the evaluation (Texel's method).
+// Usage: tune <dataset> <output file> [epochs]
+// The dataset is either a record file of TrainingRecords written by datagen, or text where each
+// line is a position followed by the game result from white's perspective:
+//   <board> <side to move> <result>
+// where the result is one of 1-0, 0-1, 1/2-1/2 or a number between 0 and 1.
+
+namespace
+{
+
+constexpr int num_squares = la::board_side * la::board_side;
+
+// The tuned parameters: the material value of each piece kind, then a square table for each
+// kind. Pawn squares are from the owner's perspective. The other pieces share one table between
+// the players, so their tables are kept symmetric between the top and bottom of the board.
+enum PieceKind { PAWN, KNIGHT, ROOK, QUEEN, KING, NUM_PIECE_KINDS };
+
+constexpr int num_material_params = NUM_PIECE_KINDS - 1; // The king has no material value.
+constexpr int num_params = num_material_params + NUM_PIECE_KINDS * num_squares;
+
+int mirror(int loc)
+{
+  return (la::board_side - 1 - loc / la::board_side) * la::board_side + loc % la::board_side;
+}
+
+int to_padded(int loc)
+{
+  return (loc / la::board_side + 2) * 10 + loc % la::board_side + 2;
+}
+
+PieceKind piece_kind(la::PieceType pt)
+{
+  switch (pt)
+  {
+    case la::PieceType::PAWN_WHITE:
+    case la::PieceType::PAWN_BLACK: return PAWN;
+    case la::PieceType::KNIGHT:     return KNIGHT;
+    case la::PieceType::ROOK:       return ROOK;
+    case la::PieceType::QUEEN:      return QUEEN;
+    default:                        return KING;
+  }
+}
+
+int square_param(PieceKind kind, la::Colour col, int loc)
+{
+  if (kind == PAWN)
+  {
+    if (col == la::Colour::BLACK) loc = mirror(loc);
+  }
+  else
+  {
+    loc = std::min(loc, mirror(loc));
+  }
+
+  return num_material_params + kind * num_squares + loc;
+}
+
+// Positions are stored as sparse lists of (parameter, +1/-1) features from white's perspective.
+struct Dataset
+{
+  std::vector<std::uint32_t> offsets;
+  std::vector<std::int16_t> features; // Parameter index + 1, negated for black's pieces.
+  std::vector<float> results;
+
+  std::size_t size() const { return results.size(); }
+};
+
+bool parse_result(const std::string& str, float& result)
+{
+  if (str == "1-0") result = 1.0f;
+  else if (str == "0-1") result = 0.0f;
+  else if (str == "1/2-1/2") result = 0.5f;
+  else
+  {
+    char* end;
+    result = std::strtof(str.c_str(), &end);
+    return *end == '\0' && result >= 0.0f && result <= 1.0f;
+  }
+
+  return true;
+}
+
+// Works for both Boards and PackedPositions.
+template <typename Position>
+void add_position(Dataset& data, const Position& position, float result)
+{
+  for (int loc = 0; loc < num_squares; loc++)
+  {
+    const auto piece = position.get_piece(loc / la::board_side, loc % la::board_side);
+    if (!piece) continue;
+
+    const int sign = piece->colour == la::Colour::WHITE ? 1 : -1;
+    const auto kind = piece_kind(piece->type);
+    if (kind != KING)
+    {
+      data.features.push_back(sign * (kind + 1));
+    }
+
+    data.features.push_back(sign * (square_param(kind, piece->colour, loc) + 1));
+  }
+
+  data.offsets.push_back(data.features.size());
+  data.results.push_back(result);
+}
+
+Dataset load(const std::string& path)
+{
+  Dataset data;
+  data.offsets.push_back(0);
+
+  if (la::is_record_file(path))
+  {
+    const la::RecordReader<TrainingRecord> records(path);
+    data.results.reserve(records.size());
+    data.offsets.reserve(records.size() + 1);
+    for (const auto& record : records)
+    {
+      add_position(data, record.position, (record.result + 1) / 2.0f);
+    }
+
+    return data;
+  }
+
+  std::ifstream file(path);
+  std::string line, board, side, result_str;
+  while (std::getline(file, line))
+  {
+    std::istringstream ss(line);
+    float result;
+    if (!(ss >> board >> side >> result_str) || !parse_result(result_str, result)) continue;
+
+    add_position(data, la::Board(board + " " + side), result);
+  }
+
+  return data;
+}
+
+// Start from the current tables.
+std::vector<double> initial_params()
+{
+  std::vector<double> params(num_params, 0.0);
+  for (const auto& [kind, pt] : {
+    std::make_pair(PAWN, la::PieceType::PAWN_WHITE),
+    std::make_pair(KNIGHT, la::PieceType::KNIGHT),
+    std::make_pair(ROOK, la::PieceType::ROOK),
+    std::make_pair(QUEEN, la::PieceType::QUEEN),
+    std::make_pair(KING, la::PieceType::KING) })
+  {
+    if (kind != KING)
+    {
+      params[kind] = la::eval::piece_scores[static_cast<int>(pt)];
+    }
+
+    for (int loc = 0; loc < num_squares; loc++)
+    {
+      params[square_param(kind, la::Colour::WHITE, loc)] =
+        la::eval::square_scores[static_cast<int>(pt)][to_padded(loc)];
+    }
+  }
+
+  return params;
+}
+
+template <typename Func>
+void parallel_for(std::size_t size, unsigned num_threads, Func func)
+{
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < num_threads; t++)
+  {
+    threads.emplace_back(func, t, size * t / num_threads, size * (t + 1) / num_threads);
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+}
+
+class Tuner
+{
+public:
+  Tuner(const Dataset& data, unsigned num_threads)
+    : data_(data), num_threads_(num_threads), evals_(data.size())
+  {
+  }
+
+  double error(const std::vector<double>& params, double k);
+  double fit_k(const std::vector<double>& params);
+  void gradient(const std::vector<double>& params, double k, std::vector<double>& grad);
+
+private:
+  const Dataset& data_;
+  unsigned num_threads_;
+  std::vector<double> evals_;
+
+  void evaluate(const std::vector<double>& params, std::size_t begin, std::size_t end);
+
+  static double sigmoid(double k, double eval)
+  {
+    return 1.0 / (1.0 + std::exp(-k * eval));
+  }
+};
+
+void Tuner::evaluate(const std::vector<double>& params, std::size_t begin, std::size_t end)
+{
+  for (std::size_t i = begin; i < end; i++)
+  {
+    double eval = 0.0;
+    for (std::size_t f = data_.offsets[i]; f < data_.offsets[i + 1]; f++)
+    {
+      const int feature = data_.features[f];
+      eval += feature > 0 ? params[feature - 1] : -params[-feature - 1];
+    }
+
+    evals_[i] = eval;
+  }
+}
+
+double Tuner::error(const std::vector<double>& params, double k)
+{
+  std::vector<double> partial(num_threads_, 0.0);
+  parallel_for(data_.size(), num_threads_, [&] (unsigned t, std::size_t begin, std::size_t end)
+  {
+    evaluate(params, begin, end);
+
+    double sum = 0.0;
+    for (std::size_t i = begin; i < end; i++)
+    {
+      const double diff = data_.results[i] - sigmoid(k, evals_[i]);
+      sum += diff * diff;
+    }
+
+    partial[t] = sum;
+  });
+
+  double sum = 0.0;
+  for (const double p : partial) sum += p;
+  return sum / data_.size();
+}
+
+// Find the scaling from evaluation to expected result which best fits the starting parameters.
+double Tuner::fit_k(const std::vector<double>& params)
+{
+  double lo = 0.0, hi = 0.1;
+  for (int i = 0; i < 60; i++)
+  {
+    const double m1 = lo + (hi - lo) / 3, m2 = hi - (hi - lo) / 3;
+    if (error(params, m1) < error(params, m2)) hi = m2;
+    else lo = m1;
+  }
+
+  return (lo + hi) / 2;
+}
+
+void Tuner::gradient(const std::vector<double>& params, double k, std::vector<double>& grad)
+{
+  std::vector<std::vector<double>> partial(num_threads_, std::vector<double>(num_params, 0.0));
+  parallel_for(data_.size(), num_threads_, [&] (unsigned t, std::size_t begin, std::size_t end)
+  {
+    evaluate(params, begin, end);
+
+    auto& thread_grad = partial[t];
+    for (std::size_t i = begin; i < end; i++)
+    {
+      const double s = sigmoid(k, evals_[i]);
+      const double d = (s - data_.results[i]) * s * (1.0 - s);
+      for (std::size_t f = data_.offsets[i]; f < data_.offsets[i + 1]; f++)
+      {
+        const int feature = data_.features[f];
+        if (feature > 0) thread_grad[feature - 1] += d;
+        else thread_grad[-feature - 1] -= d;
+      }
+    }
+  });
+
+  const double scale = 2.0 * k / data_.size();
+  for (int p = 0; p < num_params; p++)
+  {
+    double sum = 0.0;
+    for (const auto& thread_grad : partial) sum += thread_grad[p];
+    grad[p] = scale * sum;
+  }
+}
+
+void write_table(std::ofstream& out, const std::vector<double>& params, PieceKind kind, bool black)
+{
+  out << "  std::array<int, 100> {\n";
+  for (int r = -2; r < 8; r++)
+  {
+    out << "    ";
+    for (int c = -2; c < 8; c++)
+    {
+      int value = 0;
+      if (kind != NUM_PIECE_KINDS && r >= 0 && r < 6 && c >= 0 && c < 6)
+      {
+        const int loc = r * la::board_side + c;
+        const auto col = black ? la::Colour::BLACK : la::Colour::WHITE;
+        value = static_cast<int>(std::lround(params[square_param(kind, col, loc)]));
+      }
+
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "%3d", value);
+      out << buf << (r == 7 && c == 7 ? "\n" : ",");
+    }
+
+    if (r < 7) out << "\n";
+  }
+
+  out << "  }";
+}
+
+void write_eval(const std::string& path, const std::vector<double>& params)
+{
+  const auto material = [&params] (PieceKind kind)
+  {
+    return std::lround(params[kind]);
+  };
+
+  std::ofstream out(path);
+  out << "#pragma once\n\n"
+      << "#include <array>\n\n"
+      << "// This namespace contains compile-time constants we use to evaluate the position.\n"
+      << "// These values were fitted to game results by tools/tune.\n"
+      << "namespace la::eval\n{\n\n"
+      << "// Scores for each type of material.\n"
+      << "constexpr std::array<int, 7> piece_scores = { 0, "
+      << material(PAWN) << ", " << material(PAWN) << ", " << material(KNIGHT) << ", "
+      << material(ROOK) << ", " << material(QUEEN) << ", 0 };\n\n"
+      << "// For each type of material assign a bonus for that material at each location on the board.\n"
+      << "// We're using padded coordinates to save some converting later, so there are two lines of\n"
+      << "// empty padding all the way around.\n"
+      << "constexpr std::array<std::array<int, 100>, 7> square_scores =\n{\n"
+      << "  /* Padding for the NONE piece type. */\n";
+
+  write_table(out, params, NUM_PIECE_KINDS, false);
+  out << ",\n  /* PAWN_WHITE */\n";
+  write_table(out, params, PAWN, false);
+  out << ",\n  /* PAWN_BLACK */\n";
+  write_table(out, params, PAWN, true);
+  out << ",\n  /* KNIGHT */\n";
+  write_table(out, params, KNIGHT, false);
+  out << ",\n  /* ROOK */\n";
+  write_table(out, params, ROOK, false);
+  out << ",\n  /* QUEEN */\n";
+  write_table(out, params, QUEEN, false);
+  out << ",\n  /* KING */\n";
+  write_table(out, params, KING, false);
+  out << "\n};\n\n}\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "Usage: %s <dataset> <output file> [epochs]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const int num_epochs = argc > 3 ? std::atoi(argv[3]) : 1000;
+  const unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  const auto elapsed = [&start]
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+  };
+
+  const Dataset data = load(argv[1]);
+  if (data.size() == 0)
+  {
+    std::fprintf(stderr, "No positions in %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  std::printf("Loaded %zu positions in %ldms\n", data.size(), elapsed());
+
+  Tuner tuner(data, num_threads);
+  auto params = initial_params();
+  const double k = tuner.fit_k(params);
+  std::printf("K: %.6f, initial error: %.6f\n", k, tuner.error(params, k));
+
+  // Adam, with a learning rate in centipawns.
+  constexpr double learning_rate = 1.0, beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+  std::vector<double> grad(num_params), m(num_params, 0.0), v(num_params, 0.0);
+  for (int epoch = 1; epoch <= num_epochs; epoch++)
+  {
+    tuner.gradient(params, k, grad);
+
+    const double m_scale = 1.0 / (1.0 - std::pow(beta1, epoch));
+    const double v_scale = 1.0 / (1.0 - std::pow(beta2, epoch));
+    for (int p = 0; p < num_params; p++)
+    {
+      m[p] = beta1 * m[p] + (1.0 - beta1) * grad[p];
+      v[p] = beta2 * v[p] + (1.0 - beta2) * grad[p] * grad[p];
+      params[p] -= learning_rate * (m[p] * m_scale) / (std::sqrt(v[p] * v_scale) + epsilon);
+    }
+
+    if (epoch % 100 == 0 || epoch == num_epochs)
+    {
+      std::printf("Epoch %5d, error: %.6f, %ldms\n", epoch, tuner.error(params, k), elapsed());
+      std::fflush(stdout);
+    }
+  }
+
+  write_eval(argv[2], params);
+
+  return EXIT_SUCCESS;
+}
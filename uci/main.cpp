@@ -0,0 +1,643 @@
+#include "engine/board.h"
+#include "engine/shared_memory.h"
+#include "search/mcts.h"
+#include "search/search.h"
+#include "search/time_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// A headless engine speaking a UCI-like protocol on stdin and stdout.
+//
+// Commands:
+//   uci, isready, ucinewgame, quit
+//   setoption name Hash value <MB>
+//   setoption name Threads value <N>
+//   setoption name SharedHash value <name>, e.g. /la_hash, or <empty> for a private table
+//   setoption name Backend value alphabeta|mcts, where mcts searches with Threads threads and
+//     ignores the table options
+//   position startpos|fen <board> <side to move> [moves <move>...]
+//   go [movetime <ms>] [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <N>]
+//      [depth <N>] [nodes <N>] [infinite] [ponder]
+//   stop, ponderhit
+//   savehash <path> [min depth], loadhash <path>: see la::save_table
+//   removehash: remove the shared table named by the SharedHash option, see la::SharedMemory
+//
+// Positions use the FEN-style notation accepted by la::Board and moves are in the engine's
+// coordinate notation, e.g. "b1b2" or "a5a6q".
+
+namespace
+{
+
+std::mutex output_mutex;
+
+void send(const char* format, ...)
+{
+  std::lock_guard<std::mutex> lock(output_mutex);
+
+  va_list args;
+  va_start(args, format);
+  std::vprintf(format, args);
+  va_end(args);
+
+  std::putchar('\n');
+  std::fflush(stdout);
+}
+
+std::string to_lower(std::string str)
+{
+  std::transform(str.begin(), str.end(), str.begin(), [] (unsigned char c)
+  {
+    return static_cast<char>(std::tolower(c));
+  });
+
+  return str;
+}
+
+std::optional<la::Move> parse_move(const la::Board& board, const std::string& str)
+{
+  const auto target = to_lower(str);
+  for (const auto move : board.get_moves())
+  {
+    if (to_lower(board.move_to_string(move)) == target)
+    {
+      return move;
+    }
+  }
+
+  return std::nullopt;
+}
+
+// Mates are reported in moves, negative when the engine is being mated.
+std::string format_score(int score)
+{
+  if (std::abs(score) < la::eval::mate_score - la::mate_window)
+  {
+    return "cp " + std::to_string(score);
+  }
+
+  const int plies = std::max(1, la::eval::mate_score - std::abs(score));
+  const int moves = (plies + 1) / 2;
+  return "mate " + std::to_string(score > 0 ? moves : -moves);
+}
+
+enum class Backend
+{
+  ALPHA_BETA,
+  MCTS
+};
+
+struct GoCommand
+{
+  la::SearchLimits limits;
+
+  // The time to use once a ponder search becomes a normal search.
+  std::chrono::milliseconds ponder_time{0};
+
+  // Infinite and ponder searches don't report their move until they're stopped.
+  bool wait_for_stop = false;
+};
+
+// Searches and other jobs run in order on a single persistent thread, so the table it keeps
+// between searches stays warm for the life of the process. They're queued rather than waited for,
+// so the input loop is never blocked by a search and can always deliver stop and ponderhit.
+class Engine
+{
+public:
+  Engine();
+  ~Engine();
+
+  void go(const la::Board&, const GoCommand&, const la::SearchParams&, Backend);
+
+  // Stops the running search and any which are queued. Each still reports its move.
+  void stop();
+  void ponderhit();
+
+  // Queue a job to run on the search thread, e.g. to save its table, after any queued searches.
+  void run(std::function<void()>);
+
+  // Reply readyok. While a search is running or queued the reply is immediate, as the protocol
+  // requires. Otherwise it follows any queued jobs, e.g. so that a table being loaded is ready.
+  void ready();
+
+private:
+  // A search, or a job if `job` is set.
+  struct Task
+  {
+    la::Board board;
+    GoCommand command;
+    la::SearchParams params;
+    Backend backend = Backend::ALPHA_BETA;
+    bool stopped = false;
+    std::function<void()> job;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Task> tasks_;
+
+  bool quit_ = false;
+
+  // The running search.
+  bool searching_ = false;
+  bool stopped_ = false;
+  la::Board board_;
+  GoCommand command_;
+  la::SearchParams params_;
+  Backend backend_ = Backend::ALPHA_BETA;
+
+  // The shared table which last failed to map, so that later searches don't retry it until the
+  // option or the hash size changes. Only used by the search thread.
+  std::string failed_shared_hash_name_;
+  std::size_t failed_hash_size_mb_ = 0;
+
+  std::atomic<bool> stop_{false};
+
+  // Ends a ponder search once its time is up after a ponderhit.
+  std::thread timer_;
+
+  // Declared last so everything it uses is constructed before it starts.
+  std::thread thread_;
+
+  void thread_func();
+  void search();
+};
+
+Engine::Engine()
+  : thread_(&Engine::thread_func, this)
+{
+}
+
+Engine::~Engine()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+    tasks_.clear();
+    stopped_ = true;
+    stop_.store(true);
+  }
+
+  cv_.notify_all();
+  thread_.join();
+}
+
+void Engine::go(
+  const la::Board& board,
+  const GoCommand& command,
+  const la::SearchParams& params,
+  Backend backend)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Task task;
+  task.board = board;
+  task.command = command;
+  task.params = params;
+  task.backend = backend;
+  tasks_.push_back(std::move(task));
+  cv_.notify_all();
+}
+
+void Engine::stop()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& task : tasks_)
+  {
+    task.stopped = true;
+  }
+
+  if (searching_)
+  {
+    stopped_ = true;
+    stop_.store(true);
+  }
+
+  cv_.notify_all();
+}
+
+void Engine::ponderhit()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!searching_ || !command_.wait_for_stop)
+  {
+    // The ponder search may not have started yet, in which case it starts as a normal search.
+    const auto queued = std::find_if(tasks_.rbegin(), tasks_.rend(), [] (const Task& task)
+    {
+      return !task.job;
+    });
+
+    if (queued != tasks_.rend() && queued->command.wait_for_stop)
+    {
+      queued->command.wait_for_stop = false;
+      if (queued->command.ponder_time.count() > 0)
+      {
+        queued->command.limits.time = queued->command.ponder_time;
+      }
+    }
+
+    return;
+  }
+
+  // The search continues as a normal search with the time it would have been given.
+  command_.wait_for_stop = false;
+  cv_.notify_all();
+
+  if (command_.ponder_time.count() > 0 && !timer_.joinable())
+  {
+    timer_ = std::thread([this, deadline = std::chrono::steady_clock::now() + command_.ponder_time]
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_until(lock, deadline, [this] { return !searching_ || quit_; });
+      stop_.store(true);
+    });
+  }
+}
+
+void Engine::run(std::function<void()> job)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Task task;
+  task.job = std::move(job);
+  tasks_.push_back(std::move(task));
+  cv_.notify_all();
+}
+
+void Engine::ready()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const bool search_pending = searching_ ||
+    std::any_of(tasks_.begin(), tasks_.end(), [] (const Task& task) { return !task.job; });
+
+  if (search_pending)
+  {
+    lock.unlock();
+    send("readyok");
+    return;
+  }
+
+  Task task;
+  task.job = [] { send("readyok"); };
+  tasks_.push_back(std::move(task));
+  cv_.notify_all();
+}
+
+void Engine::thread_func()
+{
+  while (true)
+  {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return !tasks_.empty() || quit_; });
+      if (quit_)
+      {
+        return;
+      }
+
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      if (!task.job)
+      {
+        board_ = task.board;
+        command_ = task.command;
+        params_ = task.params;
+        backend_ = task.backend;
+        stopped_ = task.stopped;
+        stop_.store(task.stopped);
+        searching_ = true;
+      }
+    }
+
+    if (task.job)
+    {
+      task.job();
+      continue;
+    }
+
+    search();
+
+    // The ponder timer ends once it sees the search has finished.
+    std::thread timer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      searching_ = false;
+      timer = std::move(timer_);
+    }
+
+    cv_.notify_all();
+    if (timer.joinable())
+    {
+      timer.join();
+    }
+  }
+}
+
+void Engine::search()
+{
+  auto limits = command_.limits;
+  limits.stop = &stop_;
+
+  const auto report = [this] (const la::SearchData& data)
+  {
+    send(
+      "info depth %d seldepth %d score %s nodes %lu nps %lu hashfull %d time %ld pv %s",
+      data.depth,
+      data.seldepth,
+      format_score(data.score).c_str(),
+      data.total_nodes,
+      data.nodes_per_second,
+      data.hashfull,
+      data.time_taken.count(),
+      board_.move_to_string(data.best_move).c_str());
+  };
+
+  if (!params_.shared_hash_name.empty() &&
+      params_.shared_hash_name == failed_shared_hash_name_ &&
+      params_.hash_size_mb == failed_hash_size_mb_)
+  {
+    params_.shared_hash_name.clear();
+  }
+
+  la::Move best_move = 0;
+  if (!board_.get_moves().empty() && backend_ == Backend::MCTS)
+  {
+    la::mcts::Params mcts_params;
+    mcts_params.threads = static_cast<unsigned>(params_.threads);
+    best_move = la::mcts::search(board_, limits, report, mcts_params);
+  }
+  else if (!board_.get_moves().empty())
+  {
+    try
+    {
+      best_move = la::search(board_, limits, report, params_);
+    }
+    catch (const std::runtime_error& e)
+    {
+      // The shared table couldn't be mapped, so search with a private one instead.
+      send("info string %s", e.what());
+      failed_shared_hash_name_ = params_.shared_hash_name;
+      failed_hash_size_mb_ = params_.hash_size_mb;
+      params_.shared_hash_name.clear();
+      best_move = la::search(board_, limits, report, params_);
+    }
+  }
+
+  // Infinite and ponder searches must not report their move before they are told to.
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return stopped_ || !command_.wait_for_stop || quit_; });
+  }
+
+  send("bestmove %s", best_move != 0 ? to_lower(board_.move_to_string(best_move)).c_str() : "0000");
+}
+
+GoCommand parse_go(std::istringstream& ss, la::Colour player_to_move)
+{
+  GoCommand command;
+
+  int move_time = 0, wtime = 0, btime = 0, winc = 0, binc = 0, moves_to_go = 0;
+  bool infinite = false, ponder = false;
+  std::string token;
+  while (ss >> token)
+  {
+    if (token == "movetime") ss >> move_time;
+    else if (token == "wtime") ss >> wtime;
+    else if (token == "btime") ss >> btime;
+    else if (token == "winc") ss >> winc;
+    else if (token == "binc") ss >> binc;
+    else if (token == "movestogo") ss >> moves_to_go;
+    else if (token == "depth") ss >> command.limits.depth;
+    else if (token == "nodes") ss >> command.limits.nodes;
+    else if (token == "infinite") infinite = true;
+    else if (token == "ponder") ponder = true;
+  }
+
+  const bool white = player_to_move == la::Colour::WHITE;
+  la::SearchLimits timed;
+  if (move_time > 0)
+  {
+    timed.time = std::chrono::milliseconds(move_time);
+  }
+  else if ((white ? wtime : btime) > 0)
+  {
+    la::TimeControl tc;
+    tc.remaining = std::chrono::milliseconds(white ? wtime : btime);
+    tc.increment = std::chrono::milliseconds(white ? winc : binc);
+    tc.moves_to_go = moves_to_go;
+
+    const auto allocation = la::allocate_time(tc);
+    timed.time = allocation.hard;
+    timed.soft_time = allocation.soft;
+  }
+
+  if (ponder)
+  {
+    // After a ponderhit the search has to finish without knowing how far it has got, so it gets
+    // the time it would normally expect to use.
+    command.ponder_time = timed.soft_time.count() > 0 ? timed.soft_time : timed.time;
+  }
+  else if (!infinite)
+  {
+    command.limits.time = timed.time;
+    command.limits.soft_time = timed.soft_time;
+  }
+
+  command.wait_for_stop = infinite || ponder;
+  return command;
+}
+
+// Returns the position, or nothing if the command was malformed.
+std::optional<la::Board> parse_position(std::istringstream& ss)
+{
+  std::string token;
+  ss >> token;
+
+  std::optional<la::Board> board;
+  if (token == "startpos")
+  {
+    board.emplace();
+    ss >> token;
+  }
+  else if (token == "fen")
+  {
+    std::string fen, part;
+    while (ss >> part && part != "moves")
+    {
+      fen += (fen.empty() ? "" : " ") + part;
+    }
+
+    try
+    {
+      board.emplace(fen);
+    }
+    catch (const std::invalid_argument&)
+    {
+      return std::nullopt;
+    }
+
+    token = part;
+  }
+  else
+  {
+    return std::nullopt;
+  }
+
+  if (token == "moves")
+  {
+    while (ss >> token)
+    {
+      const auto move = parse_move(*board, token);
+      if (!move)
+      {
+        return std::nullopt;
+      }
+
+      board->make_move(*move);
+    }
+  }
+
+  return board;
+}
+
+}
+
+int main()
+{
+  Engine engine;
+  la::Board board;
+  la::SearchParams params;
+  Backend backend = Backend::ALPHA_BETA;
+
+  std::string line;
+  while (std::getline(std::cin, line))
+  {
+    std::istringstream ss(line);
+    std::string command;
+    if (!(ss >> command))
+    {
+      continue;
+    }
+
+    if (command == "uci")
+    {
+      send("id name Los Alamos");
+      send("option name Hash type spin default %zu min 1 max 65536", la::SearchParams().hash_size_mb);
+      send("option name Threads type spin default 1 min 1 max 256");
+      send("option name SharedHash type string default <empty>");
+      send("option name Backend type combo default alphabeta var alphabeta var mcts");
+      send("uciok");
+    }
+    else if (command == "isready")
+    {
+      engine.ready();
+    }
+    else if (command == "ucinewgame")
+    {
+      board = la::Board();
+    }
+    else if (command == "setoption")
+    {
+      std::string token, name, value;
+      ss >> token >> name >> token >> value;
+      if (name == "Hash")
+      {
+        params.hash_size_mb = std::max(1, std::atoi(value.c_str()));
+      }
+      else if (name == "Threads")
+      {
+        params.threads = std::max(1, std::atoi(value.c_str()));
+      }
+      else if (name == "SharedHash")
+      {
+        params.shared_hash_name = value == "<empty>" ? "" : value;
+      }
+      else if (name == "Backend")
+      {
+        if (value == "mcts") backend = Backend::MCTS;
+        else if (value == "alphabeta") backend = Backend::ALPHA_BETA;
+        else send("info string unknown backend: %s", value.c_str());
+      }
+    }
+    else if (command == "removehash")
+    {
+      // Processes which have the table mapped keep using it, but the next to open the name
+      // creates a new one.
+      if (!params.shared_hash_name.empty())
+      {
+        la::SharedMemory::remove(params.shared_hash_name);
+      }
+    }
+    else if (command == "position")
+    {
+      if (auto position = parse_position(ss))
+      {
+        board = std::move(*position);
+      }
+      else
+      {
+        send("info string invalid position: %s", line.c_str());
+      }
+    }
+    else if (command == "go")
+    {
+      engine.go(board, parse_go(ss, board.player_to_move()), params, backend);
+    }
+    else if (command == "savehash" || command == "loadhash")
+    {
+      std::string path;
+      int min_depth = 0;
+      ss >> path >> min_depth;
+      engine.run([command, path, min_depth]
+      {
+        try
+        {
+          if (command == "savehash")
+          {
+            la::save_table(path, min_depth);
+          }
+          else
+          {
+            la::load_table(path);
+          }
+        }
+        catch (const std::runtime_error& e)
+        {
+          send("info string %s", e.what());
+        }
+      });
+    }
+    else if (command == "stop")
+    {
+      engine.stop();
+    }
+    else if (command == "ponderhit")
+    {
+      engine.ponderhit();
+    }
+    else if (command == "quit")
+    {
+      break;
+    }
+    else
+    {
+      send("info string unknown command: %s", command.c_str());
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -6,6 +6,8 @@ extern "C"
 }
 
 #include "engine/board.h"
+#include "engine/book.h"
+#include "engine/tablebase.h"
 #include "search/search.h"
 
 #include <array>
@@ -380,6 +382,31 @@ int main(int argc, char** argv)
     search_time = std::chrono::milliseconds(std::stoi(argv[1]));
   }
 
+  // The engine plays without tablebases or a book, so failing to load them isn't fatal.
+  if (argc > 2)
+  {
+    try
+    {
+      la::tablebase::init(argv[2]);
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::cerr << "Continuing without tablebases: " << e.what() << std::endl;
+    }
+  }
+
+  if (argc > 3)
+  {
+    try
+    {
+      la::book::init(argv[3]);
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::cerr << "Continuing without a book: " << e.what() << std::endl;
+    }
+  }
+
   LosAlamosApp app;
   app.run();
 